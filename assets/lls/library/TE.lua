@@ -8,6 +8,11 @@ function TE.object_create(tilemap_name) end
 ---@return table
 function TE.object_create(tilemap_name, extends) end
 
+-- TILEMAPS:
+
+---@class Tilemap
+---@field cached boolean drawn from render texture pages, together with cached tilemaps next to it in draw order
+
 -- SOUND:
 TE.sound = {}
 
@@ -56,6 +61,15 @@ TE.gfx = {}
 -- Font Functions --
 function TE.gfx.draw_font(x, y, font, _, __, string, rgba) end
 
+---@return number width
+---@return number height
+function TE.gfx.measure_text(font, size, spacing, string) end
+
+---@return string wrapped
+---@return number width
+---@return number height
+function TE.gfx.wrap_text(font, size, spacing, string, width) end
+
 -- Sprite Functions --
 
 function TE.gfx.draw_sprite(sprite_index, image_index, x, y) end
@@ -64,6 +78,9 @@ function TE.gfx.draw_sprite_ext(sprite_index, image_index, x, y, xscale, yscale,
 
 function TE.gfx.draw_sprite_origin(sprite_index, image_index, x, y, xscale, yscale, origin_x, origin_y, keep_old_origin_pos, rotation, rgba) end
 
+-- Sprite images load on first use, this loads them ahead of time. Takes sprites or sprite names.
+function TE.gfx.preload(sprites) end
+
 -- Canvas Functions --
 
 ---@return any canvas
@@ -75,17 +92,62 @@ function TE.gfx.resize_canvas(canvas, width, height) end
 
 function TE.gfx.draw_canvas(canvas, x, y, xscale, yscale, origin_x, origin_y, angle) end
 
+-- Returns the canvas to the pool right away instead of whenever it's collected
+function TE.gfx.free_canvas(canvas) end
+
+---@return integer live_bytes
+---@return integer pooled_bytes
+---@return integer live_count
+function TE.gfx.canvas_memory() end
+
+-- Batching --
+
+-- Lets draws at the same depth be reordered by texture, cutting texture switches
+function TE.gfx.set_texture_sort(enabled) end
+
 -- Primitive shapes --
 
+-- Colors --
+
+---@return integer rgba packed as 0xRRGGBBAA, accepted anywhere rgba is
+function TE.gfx.color(r, g, b, a) end
+
 function TE.gfx.draw_rectangle(x1, y1, x2, y2, rgba) end
 function TE.gfx.draw_circle(x, y, r, rgba) end
+function TE.gfx.draw_line(x1, y1, x2, y2, rgba, thickness) end
+function TE.gfx.draw_rectangle_outline(x1, y1, x2, y2, rgba, thickness) end
+function TE.gfx.draw_circle_outline(x, y, r, rgba, thickness) end
+
+-- Particles --
+
+---@class ParticleSystem
+local ParticleSystem = {}
+function ParticleSystem:emit(count, x, y, spread_x, spread_y) end
+function ParticleSystem:update(steps) end
+function ParticleSystem:draw() end
+function ParticleSystem:clear() end
+---@return integer
+function ParticleSystem:count() end
+
+-- options (all optional): life_min, life_max, speed_min, speed_max, direction_min, direction_max, gravity_x,
+-- gravity_y, friction, spin_min, spin_max, scale_start, scale_end, color_start, color_end, animate, max_particles
+---@return ParticleSystem
+function TE.gfx.particles(sprite_index, options) end
 
 -- SHADERS:
----@return any
+
+---@class Shader
+local Shader = {}
+-- Looks the uniform up once, set() with the handle skips values the shader already has
+---@return integer handle
+function Shader:uniform(name) end
+function Shader:set(handle, data) end
+
+---@return Shader
 function TE.gfx.create_shader(fragment_code, vertex_code) end
----@return any
+---@return Shader
 function TE.gfx.create_fragment_shader(code) end
----@return any
+---@return Shader
 function TE.gfx.create_vertex_shader(code) end
 function TE.gfx.set_shader_uniform(shader, uniform, data) end
 function TE.gfx.set_shader(shader) end
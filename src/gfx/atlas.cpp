@@ -0,0 +1,102 @@
+#include <algorithm>
+#include "atlas.h"
+
+namespace GFX {
+    static constexpr unsigned int preferredPageSize = 2048;
+
+    int Atlas::Page::fit(size_t node, sf::Vector2u rect) const {
+        unsigned int x = skyline[node].x;
+        if (x + rect.x > size.x) return -1;
+
+        unsigned int y = 0;
+        unsigned int remaining = rect.x;
+        for (size_t i = node; remaining > 0; ++i) {
+            y = std::max(y, skyline[i].y);
+            if (y + rect.y > size.y) return -1;
+            remaining -= std::min(remaining, skyline[i].width);
+        }
+        return static_cast<int>(y);
+    }
+
+    void Atlas::Page::place(size_t node, sf::Vector2u position, sf::Vector2u rect) {
+        skyline.insert(skyline.begin() + node, Node { position.x, position.y + rect.y, rect.x });
+
+        // Trim or drop the nodes the new one now covers
+        unsigned int right = position.x + rect.x;
+        for (size_t i = node + 1; i < skyline.size();) {
+            Node& n = skyline[i];
+            if (n.x >= right) break;
+            unsigned int shrink = right - n.x;
+            if (n.width <= shrink) {
+                skyline.erase(skyline.begin() + i);
+                continue;
+            }
+            n.x += shrink;
+            n.width -= shrink;
+            break;
+        }
+
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+
+    Atlas::Page& Atlas::addPage(sf::Vector2u size) {
+        auto page = std::make_unique<Page>();
+        page->size = size;
+        page->skyline.push_back(Node { 0, 0, size.x });
+        // Start transparent so the gaps between packed images never bleed garbage into filtered edges
+        bool loaded = page->texture.loadFromImage(sf::Image(size, sf::Color::Transparent));
+        pages.push_back(std::move(page));
+        return *pages.back();
+    }
+
+    Atlas::Placement Atlas::insert(const sf::Image& image) {
+        sf::Vector2u rect = image.getSize();
+        unsigned int pageSize = std::min(preferredPageSize, sf::Texture::getMaximumSize());
+
+        Page* bestPage = nullptr;
+        size_t bestNode = 0;
+        unsigned int bestTop = 0, bestWidth = 0;
+
+        if (rect.x <= pageSize && rect.y <= pageSize) {
+            for (auto& page : pages) {
+                for (size_t i = 0; i < page->skyline.size(); ++i) {
+                    int y = page->fit(i, rect);
+                    if (y < 0) continue;
+
+                    unsigned int top = y + rect.y;
+                    if (!bestPage || top < bestTop || (top == bestTop && page->skyline[i].width < bestWidth)) {
+                        bestPage = page.get();
+                        bestNode = i;
+                        bestTop = top;
+                        bestWidth = page->skyline[i].width;
+                    }
+                }
+                // Fill pages in order, only moving on once one is full
+                if (bestPage) break;
+            }
+
+            if (!bestPage) {
+                bestPage = &addPage({ pageSize, pageSize });
+                bestNode = 0;
+            }
+        }
+        else {
+            bestPage = &addPage(rect);
+            bestNode = 0;
+        }
+
+        sf::Vector2u position { bestPage->skyline[bestNode].x, static_cast<unsigned int>(bestPage->fit(bestNode, rect)) };
+        bestPage->place(bestNode, position, rect);
+        bestPage->texture.update(image, position);
+
+        return Placement { &bestPage->texture, sf::Vector2i(position) };
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+namespace GFX {
+    // Packs images into a few large texture pages so that draws of different sprites share a texture.
+    // Each page is packed with a bottom-left skyline; images too big for a page get a page of their own.
+    class Atlas {
+    public:
+        struct Placement {
+            const sf::Texture* texture = nullptr;
+            sf::Vector2i position {};
+        };
+
+        static Atlas& get() {
+            static Atlas atlas;
+            return atlas;
+        }
+
+        Placement insert(const sf::Image& image);
+        size_t pageCount() const { return pages.size(); }
+        void clear() { pages.clear(); }
+
+    private:
+        struct Node {
+            unsigned int x, y, width;
+        };
+
+        struct Page {
+            sf::Texture texture;
+            sf::Vector2u size;
+            std::vector<Node> skyline;
+
+            // Lowest y the rect fits at when its left edge sits on node, or -1 when it doesn't fit there
+            int fit(size_t node, sf::Vector2u rect) const;
+            void place(size_t node, sf::Vector2u position, sf::Vector2u rect);
+        };
+
+        Atlas() = default;
+        Page& addPage(sf::Vector2u size);
+
+        std::vector<std::unique_ptr<Page>> pages;
+    };
+}
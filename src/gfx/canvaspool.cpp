@@ -0,0 +1,82 @@
+#include <algorithm>
+#include "canvaspool.h"
+#include "commandbuffer.h"
+#include "renderthread.h"
+
+namespace GFX {
+    Canvas* CanvasPool::acquire(unsigned int width, unsigned int height) {
+        sf::Vector2u size { width, height };
+        Canvas* canvas = nullptr;
+
+        // Most recently released first, it's the likeliest to still be warm
+        for (auto it = released.rbegin(); it != released.rend(); ++it) {
+            if ((*it)->rt.getSize() == size) {
+                canvas = *it;
+                released.erase(std::next(it).base());
+                pooled -= bytes(size);
+                break;
+            }
+        }
+
+        if (!canvas) {
+            RenderThread::get().waitIdle();
+            owned.push_back(std::make_unique<Canvas>());
+            canvas = owned.back().get();
+            canvas->rt = sf::RenderTexture(size);
+        }
+
+        canvas->base = false;
+        canvas->x = 0;
+        canvas->y = 0;
+        auto& commands = CommandBuffer::get();
+        commands.setView(canvas->rt, canvas->rt.getDefaultView());
+        commands.clear(canvas->rt, sf::Color::Transparent);
+
+        live += bytes(size);
+        liveCanvases++;
+        return canvas;
+    }
+
+    void CanvasPool::release(Canvas* canvas) {
+        size_t size = bytes(canvas->rt.getSize());
+        live -= size;
+        liveCanvases--;
+        pooled += size;
+        retiring.push_back(canvas);
+    }
+
+    void CanvasPool::endFrame() {
+        if (retiring.empty()) return;
+        released.insert(released.end(), retiring.begin(), retiring.end());
+        retiring.clear();
+        trim();
+    }
+
+    void CanvasPool::resized(sf::Vector2u from, sf::Vector2u to) {
+        live = live - bytes(from) + bytes(to);
+    }
+
+    void CanvasPool::clear() {
+        RenderThread::get().waitIdle();
+        released.clear();
+        retiring.clear();
+        owned.clear();
+        live = pooled = 0;
+        liveCanvases = 0;
+    }
+
+    void CanvasPool::trim() {
+        if (pooled <= maxPooledBytes) return;
+
+        // Nothing is recorded yet right after a present, only the frame in flight can still use them
+        RenderThread::get().waitIdle();
+        while (pooled > maxPooledBytes && !released.empty()) {
+            Canvas* oldest = released.front();
+            released.erase(released.begin());
+            pooled -= bytes(oldest->rt.getSize());
+
+            auto it = std::find_if(owned.begin(), owned.end(), [oldest](const auto& c) { return c.get() == oldest; });
+            owned.erase(it);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "sprite.h"
+
+namespace GFX {
+    // Keeps released canvases around by size so creating one of a size that was freed before is free. A canvas
+    // released during a frame is only reused or destroyed once that frame is presented, so commands recorded
+    // before the release never see another canvas' drawing or a freed target. All canvases share one format,
+    // so the size is the whole key.
+    class CanvasPool {
+    public:
+        // Released canvases beyond this many bytes are destroyed, oldest first
+        static constexpr size_t maxPooledBytes = 64 * 1024 * 1024;
+
+        static CanvasPool& get() {
+            static CanvasPool pool;
+            return pool;
+        }
+
+        Canvas* acquire(unsigned int width, unsigned int height);
+        void release(Canvas* canvas);
+        // Called after each present, canvases released during the frame become reusable
+        void endFrame();
+        // Called when a live canvas changes size, so the memory counts stay right
+        void resized(sf::Vector2u from, sf::Vector2u to);
+        // Destroys every canvas, live ones included, for shutdown
+        void clear();
+
+        size_t liveBytes() const { return live; }
+        size_t pooledBytes() const { return pooled; }
+        size_t liveCount() const { return liveCanvases; }
+        size_t pooledCount() const { return released.size() + retiring.size(); }
+
+    private:
+        CanvasPool() = default;
+        static size_t bytes(sf::Vector2u size) { return static_cast<size_t>(size.x) * size.y * 4; }
+        void trim();
+
+        std::vector<std::unique_ptr<Canvas>> owned;
+        std::vector<Canvas*> released;   // oldest first
+        std::vector<Canvas*> retiring;   // released during the frame being recorded
+        size_t live = 0, pooled = 0;
+        size_t liveCanvases = 0;
+    };
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include "commandbuffer.h"
+#include "spritebatch.h"
+#include "renderthread.h"
+
+namespace GFX {
+    void CommandBuffer::drawTriangles(sf::RenderTarget& target, const sf::Vertex* vertices, size_t count, const sf::RenderStates& states) {
+        Command command { Kind::TRIANGLES, &target, depthRun, states };
+        command.unit = unit;
+        command.first = recording->vertices.size();
+        command.count = count;
+        recording->vertices.insert(recording->vertices.end(), vertices, vertices + count);
+        recording->commands.push_back(command);
+        dirty.insert(&target);
+    }
+
+    void CommandBuffer::drawBuffer(sf::RenderTarget& target, const sf::VertexBuffer& buffer, size_t count, const sf::RenderStates& states) {
+        Command command { Kind::BUFFER, &target, depthRun, states };
+        command.unit = unit;
+        command.buffer = &buffer;
+        command.count = count;
+        recording->commands.push_back(command);
+        dirty.insert(&target);
+    }
+
+    bool CommandBuffer::references(const sf::VertexBuffer& buffer) const {
+        return std::any_of(recording->commands.begin(), recording->commands.end(), [&buffer](const Command& c) {
+            return c.kind == Kind::BUFFER && c.buffer == &buffer;
+        });
+    }
+
+    bool CommandBuffer::references(const sf::Shader& shader) const {
+        const Frame& frame = *recording;
+        return std::any_of(frame.commands.begin(), frame.commands.end(), [&frame, &shader](const Command& c) {
+            if (c.kind == Kind::UNIFORM) return frame.uniforms[c.first].shader == &shader;
+            return c.states.shader == &shader;
+        });
+    }
+
+    void CommandBuffer::setView(sf::RenderTarget& target, const sf::View& view) {
+        SpriteBatch::get().flush();
+        // The target's own view may be in use by a frame in flight
+        RenderThread::get().waitIdle();
+        target.setView(view);
+
+        Command command { Kind::VIEW, &target, -1 };
+        command.first = recording->views.size();
+        recording->views.push_back(view);
+        recording->commands.push_back(command);
+    }
+
+    void CommandBuffer::clear(sf::RenderTarget& target, sf::Color color) {
+        SpriteBatch::get().flush();
+        Command command { Kind::CLEAR, &target, -1 };
+        command.color = color;
+        recording->commands.push_back(command);
+        dirty.insert(&target);
+    }
+
+    void CommandBuffer::display(sf::RenderTexture& target) {
+        SpriteBatch::get().flush();
+        // Displaying resolves the texture again even when nothing changed, canvases drawn every frame skip that
+        if (dirty.erase(&target) == 0) return;
+        recording->commands.push_back(Command { Kind::DISPLAY, &target, -1 });
+    }
+
+    void CommandBuffer::setUniform(sf::Shader& shader, const std::string& name, const UniformValue& value) {
+        // Only draws of this shader need to come before, but the batch doesn't track which those are
+        SpriteBatch::get().flush();
+        Command command { Kind::UNIFORM, nullptr, -1 };
+        command.first = recording->uniforms.size();
+        recording->uniforms.push_back(UniformSet { &shader, &name, value });
+        recording->commands.push_back(command);
+    }
+
+    void CommandBuffer::setDepth(int depth) {
+        // A batch spanning two units would be sorted as a whole with the first
+        SpriteBatch::get().flush();
+        unit = unitCount++;
+        if (depthRun >= 0 && depth == currentDepth) return;
+        currentDepth = depth;
+        depthRun = runCount++;
+    }
+
+    void CommandBuffer::clearDepth() {
+        SpriteBatch::get().flush();
+        depthRun = -1;
+        unit = -1;
+    }
+
+    bool CommandBuffer::canMerge(const Command& a, const Command& b) const {
+        return a.kind == Kind::TRIANGLES && b.kind == Kind::TRIANGLES && a.target == b.target
+            && a.states.texture == b.states.texture && a.states.shader == b.states.shader
+            && a.states.blendMode == b.states.blendMode;
+    }
+
+    void CommandBuffer::sortRuns(Frame& frame) {
+        auto& commands = frame.commands;
+
+        // Contiguous commands of one unit, keyed by the texture the unit starts with
+        struct Group {
+            const sf::Texture* texture;
+            size_t first, end;
+        };
+        std::vector<Group> groups;
+        std::vector<Command> sorted;
+
+        size_t i = 0;
+        while (i < commands.size()) {
+            const Command& first = commands[i];
+            size_t end = i + 1;
+            if (first.kind == Kind::TRIANGLES && first.depthRun >= 0) {
+                while (end < commands.size() && commands[end].kind == Kind::TRIANGLES
+                    && commands[end].depthRun == first.depthRun && commands[end].target == first.target
+                    && commands[end].states.shader == first.states.shader && commands[end].states.blendMode == first.states.blendMode) {
+                    ++end;
+                }
+
+                groups.clear();
+                for (size_t c = i; c < end; ++c) {
+                    if (groups.empty() || commands[c].unit != commands[groups.back().first].unit) {
+                        groups.push_back({ commands[c].states.texture, c, c });
+                    }
+                    groups.back().end = c + 1;
+                }
+
+                if (groups.size() > 1) {
+                    std::stable_sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) {
+                        return std::less<const void*>()(a.texture, b.texture);
+                    });
+                    sorted.clear();
+                    for (const Group& g : groups) {
+                        sorted.insert(sorted.end(), commands.begin() + g.first, commands.begin() + g.end);
+                    }
+                    std::copy(sorted.begin(), sorted.end(), commands.begin() + i);
+                }
+            }
+            i = end;
+        }
+    }
+
+    void CommandBuffer::submit() {
+        SpriteBatch::get().flush();
+
+        auto& renderThread = RenderThread::get();
+        renderThread.waitIdle();
+        recording->sortByTexture = sortByTexture;
+        execute(*recording);
+        recording->clear();
+        renderThread.releaseContext();
+    }
+
+    void CommandBuffer::present(sf::RenderWindow& window) {
+        SpriteBatch::get().flush();
+        // Runs and units are only compared within a frame
+        if (depthRun < 0) {
+            runCount = 0;
+            unitCount = 0;
+        }
+        recording->sortByTexture = sortByTexture;
+
+        auto& renderThread = RenderThread::get();
+        if (!renderThread.running()) {
+            execute(*recording);
+            recording->clear();
+            window.display();
+            return;
+        }
+
+        renderThread.waitIdle();
+        Frame* frame = recording;
+        recording = (recording == &frames[0]) ? &frames[1] : &frames[0];
+        renderThread.post([this, frame, &window](bool active) {
+            if (active) {
+                execute(*frame);
+                window.display();
+            }
+            frame->clear();
+        });
+    }
+
+    void CommandBuffer::execute(Frame& frame) {
+        if (frame.sortByTexture) sortRuns(frame);
+
+        const auto& commands = frame.commands;
+        const auto& vertices = frame.vertices;
+
+        size_t i = 0;
+        while (i < commands.size()) {
+            const Command& command = commands[i];
+            switch (command.kind) {
+                case Kind::TRIANGLES: {
+                    // Neighbours with the same states are drawn together, which sorting makes more likely
+                    size_t end = i + 1;
+                    while (end < commands.size() && canMerge(command, commands[end])) ++end;
+
+                    if (end == i + 1) {
+                        command.target->draw(vertices.data() + command.first, command.count, sf::PrimitiveType::Triangles, command.states);
+                    }
+                    else {
+                        merged.clear();
+                        for (size_t j = i; j < end; ++j) {
+                            const Command& part = commands[j];
+                            merged.insert(merged.end(), vertices.begin() + part.first, vertices.begin() + part.first + part.count);
+                        }
+                        command.target->draw(merged.data(), merged.size(), sf::PrimitiveType::Triangles, command.states);
+                    }
+                    drawCalls++;
+                    i = end;
+                    continue;
+                }
+                case Kind::BUFFER:
+                    command.target->draw(*command.buffer, 0, command.count, command.states);
+                    drawCalls++;
+                    break;
+                case Kind::VIEW:
+                    command.target->setView(frame.views[command.first]);
+                    break;
+                case Kind::CLEAR:
+                    command.target->clear(command.color);
+                    break;
+                case Kind::DISPLAY:
+                    static_cast<sf::RenderTexture*>(command.target)->display();
+                    break;
+                case Kind::UNIFORM: {
+                    const UniformSet& set = frame.uniforms[command.first];
+                    const float* v = set.value.values;
+                    switch (set.value.kind) {
+                        case UniformValue::Kind::FLOAT: set.shader->setUniform(*set.name, v[0]); break;
+                        case UniformValue::Kind::VEC2: set.shader->setUniform(*set.name, sf::Glsl::Vec2 { v[0], v[1] }); break;
+                        case UniformValue::Kind::VEC3: set.shader->setUniform(*set.name, sf::Glsl::Vec3 { v[0], v[1], v[2] }); break;
+                        case UniformValue::Kind::VEC4: set.shader->setUniform(*set.name, sf::Glsl::Vec4 { v[0], v[1], v[2], v[3] }); break;
+                        case UniformValue::Kind::BOOL: set.shader->setUniform(*set.name, v[0] != 0); break;
+                        case UniformValue::Kind::TEXTURE: set.shader->setUniform(*set.name, *set.value.texture); break;
+                        case UniformValue::Kind::NONE: break;
+                    }
+                    break;
+                }
+            }
+            ++i;
+        }
+    }
+
+    unsigned int CommandBuffer::takeDrawCallCount() {
+        unsigned int count = drawCalls;
+        drawCalls = 0;
+        return count;
+    }
+}
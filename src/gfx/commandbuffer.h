@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+namespace GFX {
+    struct UniformValue {
+        enum class Kind : uint8_t {
+            NONE,
+            FLOAT,
+            VEC2,
+            VEC3,
+            VEC4,
+            BOOL,
+            TEXTURE
+        };
+
+        Kind kind = Kind::NONE;
+        float values[4] = { 0, 0, 0, 0 };
+        const sf::Texture* texture = nullptr;
+
+        bool operator==(const UniformValue& o) const {
+            return kind == o.kind && texture == o.texture && values[0] == o.values[0] && values[1] == o.values[1]
+                && values[2] == o.values[2] && values[3] == o.values[3];
+        }
+        bool operator!=(const UniformValue& o) const { return !(*this == o); }
+    };
+
+    // Draws are recorded during TE.draw and executed by submit or present, in order, apart from texture sorting
+    // within a depth. Views are applied right away as well as recorded so code reading a target's view sees
+    // the new one. Anything that must observe finished drawing (reading a target back, resizing it, changing a
+    // uniform already recorded draws use) has to submit first.
+    class CommandBuffer {
+    public:
+        static CommandBuffer& get() {
+            static CommandBuffer buffer;
+            return buffer;
+        }
+
+        void drawTriangles(sf::RenderTarget& target, const sf::Vertex* vertices, size_t count, const sf::RenderStates& states);
+        // Only the buffer is recorded, not its contents. Anything updating a buffer must submit first when
+        // references() says the frame being recorded still draws it.
+        void drawBuffer(sf::RenderTarget& target, const sf::VertexBuffer& buffer, size_t count, const sf::RenderStates& states);
+        bool references(const sf::VertexBuffer& buffer) const;
+        // Same for a shader, drawn with or given uniforms by the frame being recorded
+        bool references(const sf::Shader& shader) const;
+        void setView(sf::RenderTarget& target, const sf::View& view);
+        void clear(sf::RenderTarget& target, sf::Color color);
+        // Only records a display when something was drawn to or cleared on the target since its last one
+        void display(sf::RenderTexture& target);
+        // Name must outlive the frame, the shader keeps its uniform names around for that
+        void setUniform(sf::Shader& shader, const std::string& name, const UniformValue& value);
+
+        // Each setDepth starts a sort unit, the draws of one drawable. With sortByTexture, units at the same depth
+        // may be reordered by texture until clearDepth, the draws inside a unit always keep their order.
+        void setDepth(int depth);
+        void clearDepth();
+        bool sortByTexture = false;
+
+        // Flushes the sprite batch, then executes and forgets everything recorded, on the calling thread
+        void submit();
+        // Hands the recorded frame to the render thread (when running) to execute and display, and records the
+        // next one into the other frame
+        void present(sf::RenderWindow& window);
+
+        // Draw calls executed since the last call
+        unsigned int takeDrawCallCount();
+
+    private:
+        enum class Kind : uint8_t {
+            TRIANGLES,
+            BUFFER,
+            VIEW,
+            CLEAR,
+            DISPLAY,
+            UNIFORM
+        };
+
+        struct Command {
+            Kind kind;
+            sf::RenderTarget* target;
+            int depthRun;                   // -1 when the command must keep its place
+            sf::RenderStates states;
+            size_t first = 0, count = 0;    // into vertices, views for VIEW or uniforms for UNIFORM
+            const sf::VertexBuffer* buffer = nullptr;
+            sf::Color color;
+            int unit = -1;                  // the setDepth call it was recorded under
+        };
+
+        struct UniformSet {
+            sf::Shader* shader;
+            const std::string* name;
+            UniformValue value;
+        };
+
+        // Everything one frame recorded, owned by the main thread until presented
+        struct Frame {
+            std::vector<Command> commands;
+            std::vector<sf::Vertex> vertices;
+            std::vector<sf::View> views;
+            std::vector<UniformSet> uniforms;
+            bool sortByTexture = false;
+
+            void clear() {
+                commands.clear();
+                vertices.clear();
+                views.clear();
+                uniforms.clear();
+            }
+        };
+
+        CommandBuffer() = default;
+        void sortRuns(Frame& frame);
+        bool canMerge(const Command& a, const Command& b) const;
+        void execute(Frame& frame);
+
+        Frame frames[2];
+        Frame* recording = &frames[0];
+        std::vector<sf::Vertex> merged;     // only touched while executing
+        int depthRun = -1;
+        int runCount = 0;
+        int unit = -1;
+        int unitCount = 0;
+        int currentDepth = 0;
+        std::unordered_set<const sf::RenderTarget*> dirty;
+        std::atomic<unsigned int> drawCalls { 0 };
+    };
+}
@@ -1,8 +1,234 @@
 #include "font.h"
 #include "util/mathhelper.h"
 #include "game.h"
+#include "spritebatch.h"
+#include "renderthread.h"
+
+static uint64_t HashLayout(int size, int spacing, const char* text, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+    for (int i = 0; i < 4; ++i) mix((size >> (i * 8)) & 0xFF);
+    for (int i = 0; i < 4; ++i) mix((spacing >> (i * 8)) & 0xFF);
+    for (size_t i = 0; i < length; ++i) mix(text[i]);
+    return hash;
+}
+
+static void AppendQuad(std::vector<sf::Vertex>& vertices, sf::FloatRect rect, sf::FloatRect uv) {
+    sf::Vertex tl { rect.position, sf::Color::White, uv.position };
+    sf::Vertex tr { { rect.position.x + rect.size.x, rect.position.y }, sf::Color::White, { uv.position.x + uv.size.x, uv.position.y } };
+    sf::Vertex br { rect.position + rect.size, sf::Color::White, uv.position + uv.size };
+    sf::Vertex bl { { rect.position.x, rect.position.y + rect.size.y }, sf::Color::White, { uv.position.x, uv.position.y + uv.size.y } };
+    vertices.insert(vertices.end(), { tl, tr, br, tl, br, bl });
+}
+
+const TextLayout& Font::layout(int size, int spacing, const char* text, size_t length) {
+    uint64_t hash = HashLayout(size, spacing, text, length);
+    auto it = layouts.find(hash);
+    if (it != layouts.end()) {
+        const TextLayout& cached = it->second;
+        if (cached.size == size && cached.spacing == spacing && cached.text.compare(0, std::string::npos, text, length) == 0) {
+            return cached;
+        }
+    }
+    else if (layouts.size() >= maxLayouts) {
+        // Text that changes every frame would otherwise grow the cache forever
+        layouts.clear();
+    }
+
+    TextLayout& result = layouts[hash];
+    result.size = size;
+    result.spacing = spacing;
+    result.text.assign(text, length);
+    result.vertices.clear();
+    if (isSpriteFont) {
+        buildSpriteLayout(result);
+    }
+    else {
+        // New glyphs are rasterized into the font's texture, which a frame in flight may be sampling
+        GFX::RenderThread::get().waitIdle();
+        buildGlyphLayout(result);
+    }
+    return result;
+}
+
+const WrappedText& Font::wrap(int size, int spacing, float width, const char* text, size_t length) {
+    uint64_t hash = HashLayout(size, spacing, text, length) ^ (std::hash<float>()(width) * 1099511628211ull);
+    auto it = wraps.find(hash);
+    if (it != wraps.end()) {
+        const WrappedText& cached = it->second;
+        if (cached.size == size && cached.spacing == spacing && cached.width == width && cached.text.compare(0, std::string::npos, text, length) == 0) {
+            return cached;
+        }
+    }
+    else if (wraps.size() >= maxLayouts) {
+        wraps.clear();
+    }
+
+    if (!isSpriteFont) {
+        // Measuring rasterizes missing glyphs into the page texture, which the frame in flight may be sampling
+        GFX::RenderThread::get().waitIdle();
+    }
+
+    WrappedText& result = wraps[hash];
+    result.size = size;
+    result.spacing = spacing;
+    result.width = width;
+    result.text.assign(text, length);
+    result.wrapped.clear();
+
+    std::string line;
+    std::string candidate;
+    size_t paragraphStart = 0;
+    while (paragraphStart <= length) {
+        size_t paragraphEnd = result.text.find('\n', paragraphStart);
+        if (paragraphEnd == std::string::npos) paragraphEnd = length;
+
+        line.clear();
+        size_t wordStart = paragraphStart;
+        while (wordStart < paragraphEnd) {
+            size_t wordEnd = result.text.find(' ', wordStart);
+            if (wordEnd == std::string::npos || wordEnd > paragraphEnd) wordEnd = paragraphEnd;
+
+            if (wordEnd > wordStart) {
+                candidate = line;
+                if (!candidate.empty()) candidate += ' ';
+                candidate.append(text + wordStart, wordEnd - wordStart);
+
+                if (!line.empty() && lineWidth(size, spacing, candidate.data(), candidate.length()) > width) {
+                    result.wrapped += line;
+                    result.wrapped += '\n';
+                    line.assign(text + wordStart, wordEnd - wordStart);
+                }
+                else {
+                    line.swap(candidate);
+                }
+            }
+            wordStart = wordEnd + 1;
+        }
+
+        result.wrapped += line;
+        if (paragraphEnd < length) result.wrapped += '\n';
+        paragraphStart = paragraphEnd + 1;
+    }
+    return result;
+}
+
+float Font::lineWidth(int size, int spacing, const char* text, size_t length) const {
+    if (isSpriteFont) {
+        if (length == 0) return 0;
+        return length * (spriteIndex->width + spacing) - spacing;
+    }
+
+    float whitespaceWidth = fontIndex.getGlyph(U' ', size, false).advance;
+    float letterSpacing = (whitespaceWidth / 3.0f) * (spacing - 1.0f);
+    whitespaceWidth += letterSpacing;
+
+    float x = 0;
+    char32_t previous = 0;
+    for (size_t i = 0; i < length; ++i) {
+        char32_t current = static_cast<unsigned char>(text[i]);
+        x += fontIndex.getKerning(previous, current, size, false);
+        previous = current;
+
+        switch (current) {
+            case U' ': x += whitespaceWidth; break;
+            case U'\t': x += whitespaceWidth * 4; break;
+            default: x += fontIndex.getGlyph(current, size, false).advance + letterSpacing; break;
+        }
+    }
+    return x;
+}
+
+const sf::Texture* Font::texture(int size) const {
+    return isSpriteFont ? spriteIndex->texture : &fontIndex.getTexture(size);
+}
+
+void Font::buildSpriteLayout(TextLayout& layout) const {
+    float width = static_cast<float>(spriteIndex->width);
+    float height = static_cast<float>(spriteIndex->height);
+    sf::Vector2f origin { static_cast<float>(spriteIndex->originX), static_cast<float>(spriteIndex->originY) };
+    int frameCount = spriteIndex->frames.size();
+
+    float cx = 0;
+    float cy = 0;
+    float maxX = 0;
+    for (char c : layout.text) {
+        if (c == '\n') {
+            cx = 0;
+            cy += height;
+            continue;
+        }
+        if (c != ' ') {
+            const auto& frame = spriteIndex->frames[charMap[static_cast<unsigned char>(c)] % frameCount];
+            sf::FloatRect uv { { static_cast<float>(frame.frameX), static_cast<float>(frame.frameY) }, { width, height } };
+            AppendQuad(layout.vertices, { sf::Vector2f { cx, cy } - origin, { width, height } }, uv);
+        }
+        cx += width + layout.spacing;
+        maxX = std::max(maxX, cx - layout.spacing);
+    }
+    layout.bounds = { maxX, cy + height };
+}
+
+// Follows sf::Text's geometry for a regular style, with spacing as its letter spacing factor
+void Font::buildGlyphLayout(TextLayout& layout) const {
+    unsigned int size = layout.size;
+    float whitespaceWidth = fontIndex.getGlyph(U' ', size, false).advance;
+    float letterSpacing = (whitespaceWidth / 3.0f) * (layout.spacing - 1.0f);
+    whitespaceWidth += letterSpacing;
+    float lineSpacing = fontIndex.getLineSpacing(size);
+
+    float x = 0;
+    float y = static_cast<float>(size);
+    float maxX = 0;
+    char32_t previous = 0;
+    for (char c : layout.text) {
+        char32_t current = static_cast<unsigned char>(c);
+        if (current == U'\r') continue;
+
+        x += fontIndex.getKerning(previous, current, size, false);
+        previous = current;
+
+        if (current == U' ' || current == U'\n' || current == U'\t') {
+            switch (current) {
+                case U' ': x += whitespaceWidth; break;
+                case U'\t': x += whitespaceWidth * 4; break;
+                case U'\n': y += lineSpacing; x = 0; break;
+            }
+            maxX = std::max(maxX, x);
+            continue;
+        }
+
+        const sf::Glyph& glyph = fontIndex.getGlyph(current, size, false);
+        constexpr float padding = 1.0f;
+        sf::FloatRect rect {
+            { x + glyph.bounds.position.x - padding, y + glyph.bounds.position.y - padding },
+            { glyph.bounds.size.x + 2 * padding, glyph.bounds.size.y + 2 * padding }
+        };
+        sf::FloatRect uv {
+            { glyph.textureRect.position.x - padding, glyph.textureRect.position.y - padding },
+            { glyph.textureRect.size.x + 2 * padding, glyph.textureRect.size.y + 2 * padding }
+        };
+        AppendQuad(layout.vertices, rect, uv);
+
+        x += glyph.advance + letterSpacing;
+        maxX = std::max(maxX, x);
+    }
+    layout.bounds = { maxX, y - size + lineSpacing };
+}
 
 void FontManager::initializeLua(LuaState& L, std::filesystem::path assets) {
+    // Sprite fonts live in full userdata and own their layout caches, TTF fonts are light userdata into fonts
+    luaL_newmetatable(L, "SpriteFont");
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        static_cast<Font*>(luaL_checkudata(L, 1, "SpriteFont"))->~Font();
+        return 0;
+    });
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
     lua_getglobal(L, ENGINE_ENV);
 
         std::filesystem::path fontsDirectory = assets / "fonts";
@@ -28,12 +254,17 @@ void FontManager::initializeLua(LuaState& L, std::filesystem::path assets) {
             lua_pushcfunction(L, [](lua_State* L) -> int {
                 GFX::Sprite* spriteIndex = lua_toclassfromref<GFX::Sprite>(L, 1);
                 std::string order = std::string(lua_tostring(L, 2));
+                // Glyph layouts are cached with the frame coordinates, so they have to be final
+                if (spriteIndex == nullptr || !spriteIndex->ensureLoaded()) {
+                    return luaL_error(L, "create_font_from_sprite: sprite image can't be loaded");
+                }
                 Font* font = new(lua_newuserdata(L, sizeof(Font))) Font();
                     font->spriteIndex = spriteIndex;
                     font->isSpriteFont = true;
                     for (int i = 0; i < order.length(); ++i) {
-                        font->charMap[order[i]] = i;
+                        font->charMap[static_cast<unsigned char>(order[i])] = i;
                     }
+                luaL_setmetatable(L, "SpriteFont");
                 return 1;
             });
             lua_setfield(L, -2, "create_font_from_sprite");
@@ -48,41 +279,60 @@ void FontManager::initializeLua(LuaState& L, std::filesystem::path assets) {
                 
                 int size = lua_tointeger(L, 4);
                 int spacing = lua_tointeger(L, 5);
-                std::string string = std::string(lua_tostring(L, 6));
+                size_t length = 0;
+                const char* string = lua_tolstring(L, 6, &length);
 
                 sf::Color color = lua_tocolor(L, 7);
 
-                if (font->isSpriteFont) {
-                    auto& spriteIndex = font->spriteIndex;
-                    sf::RenderTarget& currentRenderer = *(Game::get().getRenderTarget());
-
-                    float cx = 0;
-                    float cy = 0;
-
-                    int strlength = string.length();
-                    for (int i = 0; i < strlength; ++i) {
-                        char c = string[i];
-                        if (c == '\n') {
-                            cx = 0;
-                            cy += spriteIndex->height;
-                            continue;
-                        }
-                        if (c != ' ') {
-                            spriteIndex->draw(currentRenderer, { x + cx, y + cy }, font->charMap[string[i]], { 1, 1 }, color);
-                        }
-                        cx += spriteIndex->width + spacing;
-                    }
-                }
-                else {
-                    sf::Text t(font->fontIndex, string, size);
-                    t.setFillColor(color);
-                    t.setPosition({ x, y });
-                    t.setLetterSpacing(spacing);
-                    Game::get().getRenderTarget()->draw(t);
+                const TextLayout& layout = font->layout(size, spacing, string, length);
+                if (!layout.vertices.empty()) {
+                    // Glyphs are rasterized while laying out, so the texture is fetched after
+                    GFX::SpriteBatch::get().drawTriangles(
+                        *Game::get().getRenderTarget(),
+                        font->texture(size),
+                        layout.vertices.data(),
+                        layout.vertices.size(),
+                        { x, y },
+                        color);
                 }
 
                 return 0;
             });
             lua_setfield(L, -2, "draw_font");
+
+            // measure_text
+            // Font* font, int size, int spacing, const std::string& string -> width, height
+            lua_pushcfunction(L, [](lua_State* L) -> int {
+                Font* font = static_cast<Font*>(lua_touserdata(L, 1));
+                int size = lua_tointeger(L, 2);
+                int spacing = lua_tointeger(L, 3);
+                size_t length = 0;
+                const char* string = lua_tolstring(L, 4, &length);
+
+                const TextLayout& layout = font->layout(size, spacing, string, length);
+                lua_pushnumber(L, layout.bounds.x);
+                lua_pushnumber(L, layout.bounds.y);
+                return 2;
+            });
+            lua_setfield(L, -2, "measure_text");
+
+            // wrap_text
+            // Font* font, int size, int spacing, const std::string& string, float width -> wrapped, width, height
+            lua_pushcfunction(L, [](lua_State* L) -> int {
+                Font* font = static_cast<Font*>(lua_touserdata(L, 1));
+                int size = lua_tointeger(L, 2);
+                int spacing = lua_tointeger(L, 3);
+                size_t length = 0;
+                const char* string = lua_tolstring(L, 4, &length);
+                float width = luaL_checknumber(L, 5);
+
+                const WrappedText& wrapped = font->wrap(size, spacing, width, string, length);
+                const TextLayout& layout = font->layout(size, spacing, wrapped.wrapped.data(), wrapped.wrapped.length());
+                lua_pushlstring(L, wrapped.wrapped.data(), wrapped.wrapped.length());
+                lua_pushnumber(L, layout.bounds.x);
+                lua_pushnumber(L, layout.bounds.y);
+                return 3;
+            });
+            lua_setfield(L, -2, "wrap_text");
     lua_pop(L, 2);
 }
\ No newline at end of file
@@ -1,14 +1,50 @@
 #pragma once
 
+#include <array>
 #include "luainc.h"
 #include "sprite.h"
 
+// Glyph triangles for one string, positioned relative to where it's drawn and left white to be tinted per draw
+struct TextLayout {
+    int size = 0;
+    int spacing = 0;
+    std::string text;
+    std::vector<sf::Vertex> vertices;
+    sf::Vector2f bounds;
+};
+
+// Text with line breaks inserted so no line is wider than width, where possible
+struct WrappedText {
+    int size = 0;
+    int spacing = 0;
+    float width = 0;
+    std::string text;
+    std::string wrapped;
+};
+
 class Font {
 public:
     bool isSpriteFont;
     GFX::Sprite* spriteIndex;
     sf::Font fontIndex;
-    std::unordered_map<char, int> charMap;
+    // Sprite font frame for each byte, characters missing from the order use frame 0
+    std::array<int, 256> charMap {};
+
+    // Cached by a hash of size, spacing and text, a colliding entry is rebuilt in place
+    std::unordered_map<uint64_t, TextLayout> layouts;
+    std::unordered_map<uint64_t, WrappedText> wraps;
+    static constexpr size_t maxLayouts = 1024;
+
+    const TextLayout& layout(int size, int spacing, const char* text, size_t length);
+    // Breaks lines at spaces, a single word wider than width is left on a line of its own
+    const WrappedText& wrap(int size, int spacing, float width, const char* text, size_t length);
+    // Width of text as one line, without building any geometry
+    float lineWidth(int size, int spacing, const char* text, size_t length) const;
+    const sf::Texture* texture(int size) const;
+
+private:
+    void buildSpriteLayout(TextLayout& layout) const;
+    void buildGlyphLayout(TextLayout& layout) const;
 };
 
 class FontManager {
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <random>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "luainc.h"
+#include "sprite.h"
+
+namespace GFX {
+    // How a system's particles are spawned and how they change over their life. Rates are per step.
+    struct ParticleType {
+        Sprite* sprite = nullptr;
+        float lifeMin = 30, lifeMax = 30;
+        float speedMin = 1, speedMax = 1;
+        float directionMin = 0, directionMax = 360;   // degrees, counter-clockwise like image_angle
+        float gravityX = 0, gravityY = 0;
+        float friction = 0;                           // fraction of velocity lost each step
+        float spinMin = 0, spinMax = 0;               // degrees per step
+        float scaleStart = 1, scaleEnd = 1;
+        sf::Color colorStart = sf::Color::White, colorEnd = sf::Color::White;
+        bool animate = false;                         // play the sprite's frames once over the life
+        size_t maxParticles = 65536;
+    };
+
+    // Particles kept as parallel arrays so the update loops run over contiguous floats
+    class ParticleSystem {
+    public:
+        ParticleType type;
+
+        void emit(int count, float x, float y, float spreadX = 0, float spreadY = 0);
+        void update(float dt = 1);
+        void draw(sf::RenderTarget& target) const;
+        void clear();
+        size_t size() const { return x.size(); }
+
+    private:
+        std::vector<float> x, y;
+        std::vector<float> vx, vy;
+        std::vector<float> angle, spin;
+        std::vector<float> age, invLife;
+        std::mt19937 rng { std::random_device{}() };
+
+        float random(float min, float max);
+        void removeDead();
+    };
+
+    // Adds TE.gfx.particles and the ParticleSystem metatable, with gfx on top of the stack
+    void InitializeParticleFunctions(lua_State* L);
+}
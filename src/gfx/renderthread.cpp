@@ -0,0 +1,73 @@
+#include <iostream>
+#include "renderthread.h"
+
+namespace GFX {
+    void RenderThread::start(sf::RenderWindow& window) {
+        if (running()) return;
+        this->window = &window;
+        stopping = false;
+        // A context can only be active on one thread at a time
+        if (!window.setActive(false)) {
+            std::cerr << "Failed to release the window context for the render thread\n";
+        }
+        thread = std::thread(&RenderThread::loop, this);
+    }
+
+    void RenderThread::stop() {
+        if (!running()) return;
+        waitIdle();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void RenderThread::post(std::function<void(bool active)> job) {
+        waitIdle();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = std::move(job);
+            busy = true;
+        }
+        wake.notify_one();
+    }
+
+    void RenderThread::waitIdle() {
+        if (!running()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return !busy; });
+    }
+
+    void RenderThread::releaseContext() {
+        if (!running()) return;
+        if (!window->setActive(false)) {
+            std::cerr << "Failed to release the window context\n";
+        }
+    }
+
+    void RenderThread::loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return busy || stopping; });
+            if (!busy) break;
+
+            std::function<void(bool)> current = std::move(job);
+            lock.unlock();
+
+            bool active = window->setActive(true);
+            if (!active) {
+                std::cerr << "Failed to activate the window context on the render thread, frame skipped\n";
+            }
+            current(active);
+            if (active && !window->setActive(false)) {
+                std::cerr << "Failed to release the window context on the render thread\n";
+            }
+
+            lock.lock();
+            busy = false;
+            idle.notify_all();
+        }
+    }
+}
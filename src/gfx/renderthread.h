@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <SFML/Graphics.hpp>
+
+namespace GFX {
+    // Runs frame submission and display on a thread of its own so the next step overlaps with them. The window's
+    // context is only active on the render thread while a job runs. Before touching GPU resources a queued
+    // frame may use (textures, vertex buffers, canvases), the main thread has to waitIdle.
+    class RenderThread {
+    public:
+        static RenderThread& get() {
+            static RenderThread renderThread;
+            return renderThread;
+        }
+
+        void start(sf::RenderWindow& window);
+        void stop();
+        bool running() const { return thread.joinable(); }
+
+        // Queues a job once the previous one finished. The job is told whether the window's context could be
+        // activated, it mustn't draw or display when it couldn't but still has to release what it holds.
+        void post(std::function<void(bool active)> job);
+        // Blocks until the queued job finished, returns right away when not running
+        void waitIdle();
+        // Deactivates the window on the calling thread, after it drew to the window while the render thread runs
+        void releaseContext();
+
+    private:
+        RenderThread() = default;
+        void loop();
+
+        sf::RenderWindow* window = nullptr;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake, idle;
+        std::function<void(bool active)> job;
+        bool busy = false;
+        bool stopping = false;
+    };
+}
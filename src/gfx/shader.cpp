@@ -2,19 +2,90 @@
 #include "shader.h"
 #include "sprite.h"
 #include "game.h"
+#include "commandbuffer.h"
+#include "renderthread.h"
+#include "spritebatch.h"
 
-// TODO
+int Shader::uniform(const std::string& name) {
+    auto it = handles.find(name);
+    if (it != handles.end()) return it->second;
+
+    int handle = uniforms.size();
+    uniforms.push_back(Uniform { name });
+    handles.emplace(name, handle);
+    return handle;
+}
+
+void Shader::set(int handle, const GFX::UniformValue& value) {
+    Uniform& u = uniforms[handle];
+    if (u.value == value) return;
+    u.value = value;
+    GFX::CommandBuffer::get().setUniform(baseShader, u.name, value);
+}
+
+// shader, name -> handle
+static int ShaderUniform(lua_State* L) {
+    Shader* shader = lua_toclass<Shader>(L, 1);
+    lua_pushinteger(L, shader->uniform(luaL_checkstring(L, 2)));
+    return 1;
+}
+
+// shader, handle, x, y, z, w
+// Sets a float or a vector with as many components as numbers given
+static int ShaderSet(lua_State* L) {
+    Shader* shader = lua_toclass<Shader>(L, 1);
+    lua_Integer handle = luaL_checkinteger(L, 2);
+    if (handle < 0 || handle >= static_cast<lua_Integer>(shader->uniforms.size())) {
+        return luaL_error(L, "invalid uniform handle");
+    }
+
+    int count = std::min(lua_gettop(L) - 2, 4);
+    if (count <= 0) {
+        return luaL_error(L, "set expects at least one number");
+    }
+
+    GFX::UniformValue value;
+    value.kind = static_cast<GFX::UniformValue::Kind>(static_cast<int>(GFX::UniformValue::Kind::FLOAT) + count - 1);
+    for (int i = 0; i < count; ++i) {
+        value.values[i] = static_cast<float>(luaL_checknumber(L, 3 + i));
+    }
+    shader->set(handle, value);
+    return 0;
+}
 
 void ShaderManager::initializeLua(LuaState L) {
+    luaL_newmetatable(L, "Shader");
+        lua_pushcfunction(L, [](lua_State* L) -> int {
+            Shader* shader = static_cast<Shader*>(luaL_checkudata(L, 1, "Shader"));
+            // Recorded draws and uniforms point at the shader and its uniform names
+            GFX::SpriteBatch::get().flush();
+            if (GFX::CommandBuffer::get().references(shader->baseShader)) {
+                GFX::CommandBuffer::get().submit();
+            }
+            GFX::RenderThread::get().waitIdle();
+            if (Game::get().currentShader == &shader->baseShader) {
+                Game::get().currentShader = nullptr;
+            }
+            shader->~Shader();
+            return 0;
+        });
+        lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
     lua_getglobal(L, ENGINE_ENV);
         lua_newtable(L);
 
 #define CREATE_SHADER(arg1, arg2) \
 lua_newtable(L); \
     Shader* lShader = new(lua_newuserdata(L, sizeof(Shader))) Shader(); \
+    luaL_setmetatable(L, "Shader"); \
         bool loaded = lShader->baseShader.loadFromMemory(arg1, arg2); \
         if (loaded) {} \
-    lua_setfield(L, -2, "__cpp_ptr");
+    lua_setfield(L, -2, "__cpp_ptr"); \
+    lua_pushcfunction(L, ShaderUniform); \
+    lua_setfield(L, -2, "uniform"); \
+    lua_pushcfunction(L, ShaderSet); \
+    lua_setfield(L, -2, "set");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
                 const char* frag = luaL_checkstring(L, 1);
@@ -42,53 +113,47 @@ lua_newtable(L); \
                 int baseArgs = lua_gettop(L);
 
                 Shader* ptr = lua_toclass<Shader>(L, 1);
-                sf::Shader& baseShader = ptr->baseShader;
-                const char* uniform = luaL_checkstring(L, 2);
+                int handle = ptr->uniform(luaL_checkstring(L, 2));
+                GFX::UniformValue value;
 
                 if (lua_istable(L, 3)) {
                     lua_pushstring(L, "__cpp_ptr");
                     lua_rawget(L, 3);
                     if (!lua_isnil(L, -1)) {
                         GFX::Sprite* ind = lua_toclassfromref<GFX::Sprite>(L, 3);
-                        baseShader.setUniform(uniform, ind->texture);
+                        value.kind = GFX::UniformValue::Kind::TEXTURE;
+                        // A sprite that can't be loaded leaves the uniform as it was
+                        if (ind->ensureLoaded()) {
+                            value.texture = ind->texture;
+                            ptr->set(handle, value);
+                        }
                         return 0;
                     }
                     lua_pop(L, 1);
 
                     int l = lua_rawlen(L, 3);
-
-                    if (l == 2) {
-                        float v1 = lua_tonumbertable(L, 3, 1);
-                        float v2 = lua_tonumbertable(L, 3, 2);
-                        baseShader.setUniform(uniform, sf::Glsl::Vec2 { v1, v2 });
-                        return 0;
-                    }
-                    // Vector 3
-                    if (l == 3) {
-                        float v1 = lua_tonumbertable(L, 3, 1);
-                        float v2 = lua_tonumbertable(L, 3, 2);
-                        float v3 = lua_tonumbertable(L, 3, 3);
-                        baseShader.setUniform(uniform, sf::Glsl::Vec3 { v1, v2, v3 });
-                        return 0;
-                    }
-                    // Vector 4
-                    if (l == 4) {
-                        float v1 = lua_tonumbertable(L, 3, 1);
-                        float v2 = lua_tonumbertable(L, 3, 2);
-                        float v3 = lua_tonumbertable(L, 3, 3);
-                        float v4 = lua_tonumbertable(L, 3, 4);
-                        baseShader.setUniform(uniform, sf::Glsl::Vec4 { v1, v2, v3, v4 });
+                    // Vector 2, 3 or 4
+                    if (l >= 2 && l <= 4) {
+                        value.kind = static_cast<GFX::UniformValue::Kind>(static_cast<int>(GFX::UniformValue::Kind::FLOAT) + l - 1);
+                        for (int i = 0; i < l; ++i) {
+                            value.values[i] = lua_tonumbertable(L, 3, i + 1);
+                        }
+                        ptr->set(handle, value);
                         return 0;
                     }
                 }
                 // Bool
                 if (lua_isboolean(L, 3)) {
-                    baseShader.setUniform(uniform, lua_toboolean(L, 3));
+                    value.kind = GFX::UniformValue::Kind::BOOL;
+                    value.values[0] = lua_toboolean(L, 3);
+                    ptr->set(handle, value);
                     return 0;
                 }
                 // Float
                 if (lua_isnumber(L, 3)) {
-                    baseShader.setUniform(uniform, static_cast<float>(lua_tonumber(L, 3)));
+                    value.kind = GFX::UniformValue::Kind::FLOAT;
+                    value.values[0] = static_cast<float>(lua_tonumber(L, 3));
+                    ptr->set(handle, value);
                     return 0;
                 }
 
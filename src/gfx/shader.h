@@ -1,11 +1,26 @@
 #pragma once
 
+#include <deque>
 #include <SFML/Graphics.hpp>
 #include "luainc.h"
+#include "commandbuffer.h"
 
 class Shader {
 public:
     sf::Shader baseShader;
+
+    struct Uniform {
+        std::string name;
+        GFX::UniformValue value; // last value recorded, what the shader will hold once it executes
+    };
+
+    // Handles index into uniforms, which never moves its elements so recorded commands can keep the names
+    std::deque<Uniform> uniforms;
+    std::unordered_map<std::string, int> handles;
+
+    int uniform(const std::string& name);
+    // Records the value unless the uniform already holds it
+    void set(int handle, const GFX::UniformValue& value);
 };
 
 class ShaderManager {
@@ -1,11 +1,22 @@
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include "sprite.h"
 #include "vendor/json.hpp"
+#include "spritebatch.h"
+#include "atlas.h"
+#include "particles.h"
+#include "commandbuffer.h"
+#include "renderthread.h"
+#include "canvaspool.h"
 #include "game.h"
 #include "util/mathhelper.h"
 
 static std::tuple<float, float, float, float> GetSpriteUVs(GFX::Sprite* s) {
-    sf::Vector2u texSize = s->sprite->getTexture().getSize();
+    if (!s->ensureLoaded()) {
+        return { 0, 0, 0, 0 };
+    }
+    sf::Vector2u texSize = s->texture->getSize();
     float left = s->frames[0].frameX;
     float top = s->frames[0].frameY;
     float right = left + s->width;
@@ -18,11 +29,14 @@ static std::tuple<float, float, float, float> GetSpriteUVs(GFX::Sprite* s) {
 }
 
 static std::tuple<float, float> GetSpriteTexelSize(GFX::Sprite* s) {
-    sf::Vector2u texSize = s->sprite->getTexture().getSize();
+    if (!s->ensureLoaded()) {
+        return { 0, 0 };
+    }
+    sf::Vector2u texSize = s->texture->getSize();
     return { 1.0f / texSize.x, 1.0f / texSize.y };
 }
 
-sf::Texture GFX::CreatePaddedTexture(
+sf::Image GFX::CreatePaddedImage(
     const sf::Image& source,
     unsigned int tileWidth,
     unsigned int tileHeight,
@@ -75,11 +89,79 @@ sf::Texture GFX::CreatePaddedTexture(
         }
     }
 
+    return padded;
+}
+
+sf::Texture GFX::CreatePaddedTexture(
+    const sf::Image& source,
+    unsigned int tileWidth,
+    unsigned int tileHeight,
+    unsigned int frameCountX,
+    unsigned int frameCountY,
+    unsigned int pad,
+    unsigned int offsetX,
+    unsigned int offsetY,
+    unsigned int separationX,
+    unsigned int separationY,
+    std::vector<GFX::Sprite::Frame>* outFrameCoords)
+{
+    sf::Image padded = CreatePaddedImage(source, tileWidth, tileHeight, frameCountX, frameCountY, pad, offsetX, offsetY, separationX, separationY, outFrameCoords);
     sf::Texture tex;
     bool loaded = tex.loadFromImage(padded);
     return tex;
 }
 
+// Reads the size out of the PNG header so registering a sprite never decodes it, anything else is decoded
+static sf::Vector2u ReadImageSize(const std::filesystem::path& path) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char header[24];
+
+    std::ifstream file(path, std::ios::binary);
+    if (file.read(reinterpret_cast<char*>(header), sizeof(header))
+        && std::memcmp(header, signature, sizeof(signature)) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+        auto readU32 = [&header](int at) -> unsigned int {
+            return (header[at] << 24) | (header[at + 1] << 16) | (header[at + 2] << 8) | header[at + 3];
+        };
+        return { readU32(16), readU32(20) };
+    }
+
+    sf::Image image;
+    bool loaded = image.loadFromFile(path);
+    return image.getSize();
+}
+
+// Opaque pixels inside the hitbox become set bits, one mask per frame in the same order as the padded frames
+static void BuildPreciseMasks(GFX::Sprite* spr, const sf::Image& source, int frameCountX, int frameCountY) {
+    const std::uint8_t* pixels = source.getPixelsPtr();
+    unsigned int stride = source.getSize().x;
+
+    int hbLeft = std::max(0, static_cast<int>(spr->hitbox.position.x));
+    int hbTop = std::max(0, static_cast<int>(spr->hitbox.position.y));
+    int hbRight = std::min(spr->width, static_cast<int>(spr->hitbox.position.x + spr->hitbox.size.x));
+    int hbBottom = std::min(spr->height, static_cast<int>(spr->hitbox.position.y + spr->hitbox.size.y));
+
+    spr->masks.clear();
+    for (int fy = 0; fy < frameCountY; ++fy) {
+        for (int fx = 0; fx < frameCountX; ++fx) {
+            GFX::Sprite::Mask mask;
+            mask.wordsPerRow = (spr->width + 63) / 64;
+            mask.bits.assign(static_cast<size_t>(mask.wordsPerRow) * spr->height, 0);
+
+            for (int y = hbTop; y < hbBottom; ++y) {
+                uint64_t* row = mask.bits.data() + y * mask.wordsPerRow;
+                const std::uint8_t* src = pixels + ((static_cast<size_t>(fy * spr->height + y) * stride) + fx * spr->width) * 4;
+                for (int x = hbLeft; x < hbRight; ++x) {
+                    if (src[x * 4 + 3] != 0) {
+                        row[x >> 6] |= uint64_t(1) << (x & 63);
+                    }
+                }
+            }
+
+            spr->masks.push_back(std::move(mask));
+        }
+    }
+}
+
 namespace MetaBuilder {
     template <typename T>
     void Push(const LuaState& L, const std::string& str, float T::* ptr) {
@@ -123,6 +205,11 @@ static void CreateSpriteMetatable(LuaState& L) {
                 return 1;
             }
 
+            if (strcmp(key, "precise") == 0) {
+                lua_pushboolean(L, spr->precise);
+                return 1;
+            }
+
             lua_pushvalue(L, 2);    // str
             lua_rawget(L, 1);       // val
             if (!lua_isnil(L, -1)) {
@@ -168,44 +255,133 @@ static void CreateSpriteMetatable(LuaState& L) {
 
 static void InitializeCoreFunctions(LuaState& L) {
     lua_pushcfunction(L, [](lua_State* L) -> int {
-        Game::get().currentRenderer->rt.clear(lua_tocolor(L, 1));
+        GFX::CommandBuffer::get().clear(Game::get().currentRenderer->rt, lua_tocolor(L, 1));
         return 0;
     });
     lua_setfield(L, -2, "clear");
 
+    // int r, int g, int b, int a = 255 -> color packed as 0xRRGGBBAA, accepted anywhere a color table is
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        auto channel = [L](int idx, lua_Integer fallback) {
+            return static_cast<lua_Integer>(std::clamp<lua_Integer>(luaL_optinteger(L, idx, fallback), 0, 255));
+        };
+        lua_Integer packed = (channel(1, 0) << 24) | (channel(2, 0) << 16) | (channel(3, 0) << 8) | channel(4, 255);
+        lua_pushinteger(L, packed);
+        return 1;
+    });
+    lua_setfield(L, -2, "color");
+
     lua_pushcfunction(L, [](lua_State* L) -> int {
         Game::get().canvasWidth = lua_tonumber(L, 1);
         Game::get().canvasHeight = lua_tonumber(L, 2);
         return 0;
     });
     lua_setfield(L, -2, "set_size");
+
+    // bool enabled
+    // Lets draws of instances at the same depth be reordered to group them by texture
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        GFX::CommandBuffer::get().sortByTexture = lua_toboolean(L, 1);
+        return 0;
+    });
+    lua_setfield(L, -2, "set_texture_sort");
+
+    // Loads sprites ahead of their first use, given a list of sprites or sprite names
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        int count = lua_rawlen(L, 1);
+        for (int i = 1; i <= count; ++i) {
+            lua_rawgeti(L, 1, i);
+            GFX::Sprite* sprite = nullptr;
+            if (lua_type(L, -1) == LUA_TSTRING) {
+                auto it = GFX::sprites.find(lua_tostring(L, -1));
+                if (it != GFX::sprites.end()) sprite = it->second.get();
+            }
+            else if (lua_istable(L, -1)) {
+                sprite = lua_toclassfromref<GFX::Sprite>(L, -1);
+            }
+            lua_pop(L, 1);
+
+            if (sprite == nullptr) {
+                return luaL_error(L, "preload: entry %d is not a sprite", i);
+            }
+            if (!sprite->ensureLoaded()) {
+                return luaL_error(L, "preload: failed to load %s", sprite->imagePath.string().c_str());
+            }
+        }
+        return 0;
+    });
+    lua_setfield(L, -2, "preload");
+}
+
+// Canvas userdata only points into the pool, so freeing one hands its texture to the next create_canvas
+struct CanvasHandle {
+    GFX::Canvas* canvas;
+};
+
+static GFX::Canvas* ToCanvas(lua_State* L, int idx) {
+    CanvasHandle* handle = static_cast<CanvasHandle*>(luaL_checkudata(L, idx, "Canvas"));
+    if (handle->canvas == nullptr) {
+        luaL_error(L, "canvas has been freed");
+    }
+    return handle->canvas;
+}
+
+static void ReleaseCanvas(CanvasHandle* handle) {
+    if (handle->canvas == nullptr) return;
+
+    Game& game = Game::get();
+    if (game.currentRenderer == handle->canvas) {
+        game.currentRenderer = nullptr;
+    }
+    GFX::CanvasPool::get().release(handle->canvas);
+    handle->canvas = nullptr;
 }
 
 static void InitializeCanvasFunctions(LuaState& L) {
     luaL_newmetatable(L, "Canvas");
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        ReleaseCanvas(static_cast<CanvasHandle*>(luaL_checkudata(L, 1, "Canvas")));
+        return 0;
+    });
+    lua_setfield(L, -2, "__gc");
     lua_pop(L, 1);
 
     lua_pushcfunction(L, [](lua_State* L) -> int {
         unsigned int width =    static_cast<unsigned int>(lua_tointeger(L, 1));
         unsigned int height =   static_cast<unsigned int>(lua_tointeger(L, 2));
 
-        void* mem = lua_newuserdata(L, sizeof(GFX::Canvas));
-        auto canvas = new(mem) GFX::Canvas();
-        canvas->base = false;
-        canvas->rt = sf::RenderTexture(sf::Vector2u { width, height });
+        void* mem = lua_newuserdata(L, sizeof(CanvasHandle));
+        new(mem) CanvasHandle { GFX::CanvasPool::get().acquire(width, height) };
         luaL_setmetatable(L, "Canvas");
 
         return 1;
     });
     lua_setfield(L, -2, "create_canvas");
 
+    // Returns the canvas to the pool right away instead of whenever it's collected
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        ReleaseCanvas(static_cast<CanvasHandle*>(luaL_checkudata(L, 1, "Canvas")));
+        return 0;
+    });
+    lua_setfield(L, -2, "free_canvas");
+
+    // Bytes held by live canvases, bytes kept for reuse, live canvas count
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        auto& pool = GFX::CanvasPool::get();
+        lua_pushinteger(L, static_cast<lua_Integer>(pool.liveBytes()));
+        lua_pushinteger(L, static_cast<lua_Integer>(pool.pooledBytes()));
+        lua_pushinteger(L, static_cast<lua_Integer>(pool.liveCount()));
+        return 3;
+    });
+    lua_setfield(L, -2, "canvas_memory");
+
     lua_pushcfunction(L, [](lua_State* L) -> int {
         if (lua_isnil(L, 1)) {
             Game::get().currentRenderer = nullptr;
         }
         else {
-            GFX::Canvas* canvas = static_cast<GFX::Canvas*>(luaL_checkudata(L, 1, "Canvas"));
-            Game::get().currentRenderer = canvas;
+            Game::get().currentRenderer = ToCanvas(L, 1);
         }
         return 0;
     });
@@ -213,7 +389,7 @@ static void InitializeCanvasFunctions(LuaState& L) {
 
     // canvas, x, y
     lua_pushcfunction(L, [](lua_State* L) -> int {
-        GFX::Canvas* canvas = static_cast<GFX::Canvas*>(luaL_checkudata(L, 1, "Canvas"));
+        GFX::Canvas* canvas = ToCanvas(L, 1);
 
         lua_pushnumber(L, canvas->x);
         lua_pushnumber(L, canvas->y);
@@ -224,23 +400,11 @@ static void InitializeCanvasFunctions(LuaState& L) {
 
     // canvas, x, y
     lua_pushcfunction(L, [](lua_State* L) -> int {
-        GFX::Canvas* canvas = static_cast<GFX::Canvas*>(luaL_checkudata(L, 1, "Canvas"));
+        GFX::Canvas* canvas = ToCanvas(L, 1);
 
         float x = luaL_checknumber(L, 2);
         float y = luaL_checknumber(L, 3);
-
-        canvas->x = x;
-        canvas->y = y;
-
-        auto targetSize = canvas->rt.getSize();
-        sf::View view = canvas->rt.getView();
-
-        view.setCenter({
-            x + (targetSize.x / 2.0f),
-            y + (targetSize.y / 2.0f)
-        });
-
-        canvas->rt.setView(view);
+        canvas->setRenderPosition(x, y);
         
         return 0;
     });
@@ -248,10 +412,13 @@ static void InitializeCanvasFunctions(LuaState& L) {
 
     // canvas, width, height
     lua_pushcfunction(L, [](lua_State* L) -> int {
-        GFX::Canvas* canvas = static_cast<GFX::Canvas*>(luaL_checkudata(L, 1, "Canvas"));
+        GFX::Canvas* canvas = ToCanvas(L, 1);
         unsigned int width = static_cast<unsigned int>(lua_tointeger(L, 2));
         unsigned int height = static_cast<unsigned int>(lua_tointeger(L, 3));
+        sf::Vector2u previous = canvas->rt.getSize();
+        GFX::CommandBuffer::get().submit();
         bool res = canvas->rt.resize({ width, height });
+        GFX::CanvasPool::get().resized(previous, canvas->rt.getSize());
         lua_pushboolean(L, res);
         return 1;
     });
@@ -259,7 +426,7 @@ static void InitializeCanvasFunctions(LuaState& L) {
 
     // sf::RenderTexture* target, float x, float y, float xscale, float yscale, float originx, float originy, float angle
     lua_pushcfunction(L, [](lua_State* L) -> int {
-        GFX::Canvas* canvas = static_cast<GFX::Canvas*>(luaL_checkudata(L, 1, "Canvas"));
+        GFX::Canvas* canvas = ToCanvas(L, 1);
         float x = lua_tonumber(L, 2);
         float y = lua_tonumber(L, 3);
         float xscale = lua_tonumber(L, 4);
@@ -268,14 +435,10 @@ static void InitializeCanvasFunctions(LuaState& L) {
         float originy = lua_tonumber(L, 7);
         float angle = lua_tonumber(L, 8);
 
-        canvas->rt.display();
-        Game& game = Game::get();
-        sf::Sprite s(canvas->rt.getTexture());
-        s.setPosition({ x, y });
-        s.setScale({ xscale, yscale });
-        s.setOrigin({ originx, originy });
-        s.setRotation(sf::degrees(angle));
-        game.getRenderTarget()->draw(s, game.currentShader);
+        GFX::CommandBuffer::get().display(canvas->rt);
+        const sf::Texture& texture = canvas->rt.getTexture();
+        sf::IntRect rect({}, sf::Vector2i(texture.getSize()));
+        GFX::SpriteBatch::get().drawSprite(*Game::get().getRenderTarget(), texture, rect, { x, y }, { originx, originy }, { xscale, yscale }, angle, sf::Color::White);
 
         return 0;
     });
@@ -371,38 +534,64 @@ static void InitializeDrawFunctions(LuaState& L) {
         float x2 = luaL_checknumber(L, 3);
         float y2 = luaL_checknumber(L, 4);
         sf::Color color = lua_tocolor(L, 5);
-        sf::RectangleShape rs({ x2 - x1, y2 - y1 });
-        rs.setPosition({ x1, y1 });
-        rs.setFillColor(color);
-        rs.setTexture(&GFX::whiteTexture);
-        rs.setTextureRect({ { 0, 0 }, { 1, 1 } });
-        Game& game = Game::get();
-        game.getRenderTarget()->draw(rs, game.currentShader);
+        GFX::SpriteBatch::get().drawRectangle(*Game::get().getRenderTarget(), { { x1, y1 }, { x2 - x1, y2 - y1 } }, color);
 
         return 0;
     });
     lua_setfield(L, -2, "draw_rectangle");
 
+    // float x1, float y1, float x2, float y2, ColorTable color, float thickness = 1
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        float x1 = luaL_checknumber(L, 1);
+        float y1 = luaL_checknumber(L, 2);
+        float x2 = luaL_checknumber(L, 3);
+        float y2 = luaL_checknumber(L, 4);
+        sf::Color color = lua_tocolor(L, 5);
+        float thickness = luaL_optnumber(L, 6, 1);
+        GFX::SpriteBatch::get().drawRectangleOutline(*Game::get().getRenderTarget(), { { x1, y1 }, { x2 - x1, y2 - y1 } }, thickness, color);
+
+        return 0;
+    });
+    lua_setfield(L, -2, "draw_rectangle_outline");
+
+    // float x1, float y1, float x2, float y2, ColorTable color, float thickness = 1
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        float x1 = luaL_checknumber(L, 1);
+        float y1 = luaL_checknumber(L, 2);
+        float x2 = luaL_checknumber(L, 3);
+        float y2 = luaL_checknumber(L, 4);
+        sf::Color color = lua_tocolor(L, 5);
+        float thickness = luaL_optnumber(L, 6, 1);
+        GFX::SpriteBatch::get().drawLine(*Game::get().getRenderTarget(), { x1, y1 }, { x2, y2 }, thickness, color);
+
+        return 0;
+    });
+    lua_setfield(L, -2, "draw_line");
+
     // float x, float y, float r, ColorTable color
     lua_pushcfunction(L, [](lua_State* L) -> int {
         float x = luaL_checknumber(L, 1);
         float y = luaL_checknumber(L, 2);
         float radius = luaL_checknumber(L, 3);
         sf::Color color = lua_tocolor(L, 4);
+        GFX::SpriteBatch::get().drawCircle(*Game::get().getRenderTarget(), { x, y }, radius, color);
 
-        sf::CircleShape cs(radius);
-        cs.setPosition({ x, y });
-        cs.setOrigin({ radius, radius });
-        cs.setFillColor(color);
-        cs.setTexture(&GFX::whiteTexture);
-        cs.setTextureRect({ { 0, 0 }, { 1, 1 } });
+        return 0;
+    });
+    lua_setfield(L, -2, "draw_circle");
 
-        Game& game = Game::get();
-        game.getRenderTarget()->draw(cs, game.currentShader);
+    // float x, float y, float r, ColorTable color, float thickness = 1
+    lua_pushcfunction(L, [](lua_State* L) -> int {
+        float x = luaL_checknumber(L, 1);
+        float y = luaL_checknumber(L, 2);
+        float radius = luaL_checknumber(L, 3);
+        sf::Color color = lua_tocolor(L, 4);
+        float thickness = luaL_optnumber(L, 5, 1);
+        GFX::SpriteBatch::get().drawCircleOutline(*Game::get().getRenderTarget(), { x, y }, radius, thickness, color);
 
         return 0;
     });
-    lua_setfield(L, -2, "draw_circle");
+    lua_setfield(L, -2, "draw_circle_outline");
 }
 
 static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path& assets) {
@@ -421,11 +610,6 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
             if (!it.is_directory() && it.path().extension() != ".png") continue;
 
             bool isPng = !it.is_directory();
-            int pad = 2;
-            sf::Image src;
-            int frameCount = 0;
-            sf::Texture tex;
-            std::vector<GFX::Sprite::Frame> frameCoords;
             int frameCountX = -1, frameCountY = -1;
 
             GFX::sprites[identifier] = std::make_unique<GFX::Sprite>();
@@ -448,10 +632,11 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
                 spr->width = j["size"][0].get<int>();
                 spr->height = j["size"][1].get<int>();
 
-                bool imageLoaded = src.loadFromFile(it.path() / "frames.png");
+                spr->imagePath = it.path() / "frames.png";
+                sf::Vector2u size = ReadImageSize(spr->imagePath);
 
-                int offByWidth = src.getSize().x / spr->width;
-                int offByHeight = src.getSize().y / spr->height;
+                int offByWidth = size.x / spr->width;
+                int offByHeight = size.y / spr->height;
                 frameCountX = offByWidth;
                 frameCountY = offByHeight;
 
@@ -463,11 +648,11 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
                 spr->originX = j["origin"][0].get<int>();
                 spr->originY = j["origin"][1].get<int>();
 
-                tex = GFX::CreatePaddedTexture(src, spr->width, spr->height, frameCountX, frameCountY, pad, 0, 0, 0, 0, &frameCoords);
+                spr->precise = j.value("precise", false);
             }
             else {
-                bool imageLoaded = src.loadFromFile(it.path().string());
-                auto size = src.getSize();
+                spr->imagePath = it.path();
+                sf::Vector2u size = ReadImageSize(spr->imagePath);
                 bool autoSize = true;
                 bool autoHitbox = true;
 
@@ -480,14 +665,14 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
                         spr->width = j["size"][0].get<int>();
                         spr->height = j["size"][1].get<int>();
 
-                        int offByWidth = src.getSize().x / spr->width;
-                        int offByHeight = src.getSize().y / spr->height;
+                        int offByWidth = size.x / spr->width;
+                        int offByHeight = size.y / spr->height;
                         frameCountX = offByWidth;
                         frameCountY = offByHeight;
                     }
                     if (spr->width == -1 || spr->height == -1) {
-                    spr->width = src.getSize().x;
-                    spr->height = src.getSize().y;
+                    spr->width = size.x;
+                    spr->height = size.y;
                         frameCountX = 1;
                         frameCountY = 1;
                     }
@@ -502,6 +687,7 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
                         spr->originX = j["origin"][0].get<int>();
                         spr->originY = j["origin"][1].get<int>();
                     }
+                    spr->precise = j.value("precise", false);
                 }
                     
                 if (autoSize) {
@@ -519,22 +705,40 @@ static void LoadSpritesIntoEnvironment(LuaState& L, const std::filesystem::path&
                 }
 
                 if (frameCountY == -1) {
-                    tex = CreatePaddedTexture(src, spr->width, spr->height, frameCountX, 1, pad, 0, 0, 0, 0, &frameCoords);
-                }
-                else {
-                    tex = CreatePaddedTexture(src, spr->width, spr->height, frameCountX, frameCountY, pad, 0, 0, 0, 0, &frameCoords);
+                    frameCountY = 1;
                 }
             }
 
-            spr->texture = tex;
-            spr->sprite = std::make_unique<sf::Sprite>(spr->texture);
-            spr->frames = frameCoords;
+            spr->frameCountX = frameCountX;
+            spr->frameCountY = frameCountY;
+            // Placeholder coordinates until the image is packed, so frame counts are right from the start
+            spr->frames.assign(static_cast<size_t>(frameCountX) * frameCountY, GFX::Sprite::Frame(0, 0));
+
+            // Masks need the pixels, and collisions can't wait for the sprite's first draw
+            if (spr->precise) {
+                spr->ensureLoaded();
+            }
         }
     }
 }
 
 namespace GFX {
     sf::Texture whiteTexture;
+
+    void Canvas::setRenderPosition(float x, float y) {
+        this->x = x;
+        this->y = y;
+
+        auto targetSize = rt.getSize();
+        sf::View view = rt.getView();
+
+        view.setCenter({
+            x + (targetSize.x / 2.0f),
+            y + (targetSize.y / 2.0f)
+        });
+
+        CommandBuffer::get().setView(rt, view);
+    }
     std::unordered_map<std::string, std::unique_ptr<GFX::Sprite>> sprites;
 
     void initializeLua(LuaState& L, const std::filesystem::path& assets) {
@@ -549,43 +753,84 @@ namespace GFX {
                 InitializeCoreFunctions(L);
                 InitializeCanvasFunctions(L);
                 InitializeDrawFunctions(L);
+                InitializeParticleFunctions(L);
             lua_setfield(L, -2, "gfx");
         lua_pop(L, 1);
     }
 
-    void Sprite::drawOrigin(sf::RenderTarget &target, sf::Vector2f position, float frame, sf::Vector2f scale, sf::Vector2f origin, sf::Color color, float rotation) const {
+    bool Sprite::ensureLoaded() {
+        if (texture) return true;
+        if (loadFailed) return false;
+
+        sf::Image source;
+        if (!source.loadFromFile(imagePath)) {
+            // Reported once, trying again on every draw would only repeat the error
+            std::cerr << "Failed to load sprite image " << imagePath.string() << "\n";
+            loadFailed = true;
+            return false;
+        }
+
+        // The padding stays part of the packed image, so neighbours on a page never bleed into each other
+        std::vector<Frame> frameCoords;
+        sf::Image padded = CreatePaddedImage(source, width, height, frameCountX, frameCountY, 2, 0, 0, 0, 0, &frameCoords);
+
+        // Packing writes into a page a frame in flight may be drawing from
+        RenderThread::get().waitIdle();
+        auto placement = Atlas::get().insert(padded);
+        for (auto& frame : frameCoords) {
+            frame.frameX += placement.position.x;
+            frame.frameY += placement.position.y;
+        }
+        texture = placement.texture;
+        frames = frameCoords;
+
+        if (precise) {
+            BuildPreciseMasks(this, source, frameCountX, frameCountY);
+        }
+        return true;
+    }
+
+    const sf::Texture& Sprite::repeatedTexture() {
+        if (!repeated) {
+            if (!ensureLoaded()) return whiteTexture;
+            // Decoded again rather than read back from the atlas page, frame 0 sits at the image's corner
+            sf::Image source;
+            repeated = std::make_unique<sf::Texture>();
+            if (!source.loadFromFile(imagePath) || !repeated->loadFromImage(source, false, sf::IntRect({ 0, 0 }, { width, height }))) {
+                std::cerr << "Failed to load sprite image " << imagePath.string() << "\n";
+                *repeated = whiteTexture;
+            }
+            repeated->setRepeated(true);
+        }
+        return *repeated;
+    }
+
+    const Sprite::Mask* Sprite::frameMask(float frame) const {
+        if (masks.empty()) return nullptr;
+        int count = masks.size();
+        int frameIndex = static_cast<int>(floorf(frame)) % count;
+        if (frameIndex < 0) frameIndex += count;
+        return &masks[frameIndex];
+    }
+
+    void Sprite::drawOrigin(sf::RenderTarget &target, sf::Vector2f position, float frame, sf::Vector2f scale, sf::Vector2f origin, sf::Color color, float rotation) {
+        if (!ensureLoaded()) return;
         int frameCount = frames.size();
         int frameIndex = static_cast<int>(frame) % frameCount;
     
         int texX = frames[frameIndex].frameX;
         int texY = frames[frameIndex].frameY;
-        sprite->setTextureRect({ { texX, texY }, { width, height } });
-    
-        sprite->setPosition(position);
-        sprite->setOrigin(origin);
-        sprite->setScale(scale);
-        sprite->setColor(color);
-        sprite->setRotation(sf::degrees(rotation));
-    
-        const sf::Sprite& r = *(sprite.get());
-        target.draw(r, Game::get().currentShader);
+        SpriteBatch::get().drawSprite(target, *texture, { { texX, texY }, { width, height } }, position, origin, scale, rotation, color);
     }
     
-    void Sprite::draw(sf::RenderTarget &target, sf::Vector2f position, float frame, sf::Vector2f scale, sf::Color color, float rotation) const {
+    void Sprite::draw(sf::RenderTarget &target, sf::Vector2f position, float frame, sf::Vector2f scale, sf::Color color, float rotation) {
+        if (!ensureLoaded()) return;
         int frameCount = frames.size();
         int frameIndex = static_cast<int>(floorf(frame)) % frameCount;
     
         int texX = frames[frameIndex].frameX;
         int texY = frames[frameIndex].frameY;
-        sprite->setTextureRect({ { texX, texY }, { width, height } });
-    
-        sprite->setPosition(position);
-        sprite->setOrigin({ static_cast<float>(originX), static_cast<float>(originY) });
-        sprite->setScale(scale);
-        sprite->setColor(color);
-        sprite->setRotation(sf::degrees(-rotation));
-    
-        const sf::Sprite& r = *(sprite.get());
-        target.draw(r, Game::get().currentShader);
+        sf::Vector2f origin { static_cast<float>(originX), static_cast<float>(originY) };
+        SpriteBatch::get().drawSprite(target, *texture, { { texX, texY }, { width, height } }, position, origin, scale, -rotation, color);
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -11,6 +11,9 @@ namespace GFX {
         bool base;
         sf::RenderTexture rt;
         ~Canvas() = default;
+
+        // Moves the view so x, y is the canvas' top left corner
+        void setRenderPosition(float x, float y);
     };
 
     class Sprite {
@@ -21,14 +24,41 @@ namespace GFX {
             Frame(int x, int y) : frameX(x), frameY(y) {}
         };
 
+        // Per-frame collision bitset, one bit per pixel (lowest bit is leftmost). Rows are padded to whole words.
+        struct Mask {
+            int wordsPerRow = 0;
+            std::vector<uint64_t> bits {};
+
+            const uint64_t* row(int y) const { return bits.data() + y * wordsPerRow; }
+            bool test(int x, int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+        };
+
         int ref;
         int width = 0, height = 0;
         int originX = 0, originY = 0;
         sf::FloatRect hitbox {};
         std::vector<Frame> frames {};
 
-        sf::Texture texture;
-        std::unique_ptr<sf::Sprite> sprite;
+        // Precise sprites carry one mask per frame, tested after the hitbox
+        bool precise = false;
+        std::vector<Mask> masks {};
+
+        const Mask* frameMask(float frame) const;
+
+        // Atlas page the frames live on, frame coordinates are relative to it. Null until the image is loaded.
+        const sf::Texture* texture = nullptr;
+
+        // Startup only reads metadata, the image is decoded, padded and packed the first time it's needed
+        std::filesystem::path imagePath {};
+        int frameCountX = 1, frameCountY = 1;
+        // False when the image can't be loaded, the sprite then stays unloaded and draws nothing
+        bool ensureLoaded();
+        bool loadFailed = false;
+
+        // Frame 0 in a texture of its own with repeat wrapping, built on first use since atlas pages can't wrap.
+        // The white texture when the image can't be loaded.
+        const sf::Texture& repeatedTexture();
+        mutable std::unique_ptr<sf::Texture> repeated;
 
         void drawOrigin(
             sf::RenderTarget& target,
@@ -37,7 +67,7 @@ namespace GFX {
             sf::Vector2f scale,
             sf::Vector2f origin,
             sf::Color color,
-            float rotation) const;
+            float rotation);
 
         void draw(
             sf::RenderTarget& target,
@@ -45,13 +75,26 @@ namespace GFX {
             float frame = 0,
             sf::Vector2f scale = { 1.0f, 1.0f },
             sf::Color color = sf::Color::White,
-            float rotation = 0) const;
+            float rotation = 0);
     };
 
     extern sf::Texture whiteTexture;
 
     extern std::unordered_map<std::string, std::unique_ptr<GFX::Sprite>> sprites;
 
+    sf::Image CreatePaddedImage(
+        const sf::Image& source,
+        unsigned int tileWidth,
+        unsigned int tileHeight,
+        unsigned int frameCountX,
+        unsigned int frameCountY,
+        unsigned int pad = 1,
+        unsigned int offsetX = 0,
+        unsigned int offsetY = 0,
+        unsigned int separationX = 0,
+        unsigned int separationY = 0,
+        std::vector<GFX::Sprite::Frame>* outFrameCoords = nullptr);
+
     sf::Texture CreatePaddedTexture(
         const sf::Image& source,
         unsigned int tileWidth,
@@ -66,4 +109,4 @@ namespace GFX {
         std::vector<GFX::Sprite::Frame>* outFrameCoords = nullptr);
 
     void initializeLua(LuaState& L, const std::filesystem::path& assets);
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include "spritebatch.h"
+#include "sprite.h"
+#include "commandbuffer.h"
+#include "game.h"
+#include "util/mathhelper.h"
+
+namespace GFX {
+    void SpriteBatch::begin(sf::RenderTarget& target, const sf::Texture* texture) {
+        const sf::Shader* shader = Game::get().currentShader;
+        if (&target != this->target || texture != this->texture || shader != this->shader) {
+            flush();
+            this->target = &target;
+            this->texture = texture;
+            this->shader = shader;
+        }
+    }
+
+    void SpriteBatch::drawQuad(sf::RenderTarget& target, const sf::Texture* texture, const sf::Vertex* quad) {
+        begin(target, texture);
+
+        vertices.push_back(quad[0]);
+        vertices.push_back(quad[1]);
+        vertices.push_back(quad[2]);
+        vertices.push_back(quad[0]);
+        vertices.push_back(quad[2]);
+        vertices.push_back(quad[3]);
+    }
+
+    void SpriteBatch::drawSprite(
+        sf::RenderTarget& target,
+        const sf::Texture& texture,
+        const sf::IntRect& rect,
+        sf::Vector2f position,
+        sf::Vector2f origin,
+        sf::Vector2f scale,
+        float rotation,
+        sf::Color color)
+    {
+        float w = static_cast<float>(rect.size.x);
+        float h = static_cast<float>(rect.size.y);
+        sf::Vector2f local[4] = {
+            { -origin.x, -origin.y },
+            { w - origin.x, -origin.y },
+            { w - origin.x, h - origin.y },
+            { -origin.x, h - origin.y }
+        };
+
+        float cosA = 1.0f, sinA = 0.0f;
+        if (rotation != 0) {
+            float rad = Deg2Rad(rotation);
+            cosA = std::cos(rad);
+            sinA = std::sin(rad);
+        }
+
+        float left = static_cast<float>(rect.position.x);
+        float top = static_cast<float>(rect.position.y);
+        sf::Vector2f texCoords[4] = {
+            { left, top },
+            { left + w, top },
+            { left + w, top + h },
+            { left, top + h }
+        };
+
+        sf::Vertex quad[4];
+        for (int i = 0; i < 4; ++i) {
+            float sx = local[i].x * scale.x;
+            float sy = local[i].y * scale.y;
+            quad[i].position = { position.x + sx * cosA - sy * sinA, position.y + sx * sinA + sy * cosA };
+            quad[i].color = color;
+            quad[i].texCoords = texCoords[i];
+        }
+
+        drawQuad(target, &texture, quad);
+    }
+
+    void SpriteBatch::drawTriangles(
+        sf::RenderTarget& target,
+        const sf::Texture* texture,
+        const sf::Vertex* triangles,
+        size_t count,
+        sf::Vector2f offset,
+        sf::Color color)
+    {
+        begin(target, texture);
+
+        size_t start = vertices.size();
+        vertices.insert(vertices.end(), triangles, triangles + count);
+        for (size_t i = start; i < vertices.size(); ++i) {
+            vertices[i].position += offset;
+            vertices[i].color = color;
+        }
+    }
+
+    void SpriteBatch::pushSolid(sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, sf::Color color) {
+        // Every corner samples the middle of the white texel
+        sf::Vector2f uv { 0.5f, 0.5f };
+        vertices.push_back({ a, color, uv });
+        vertices.push_back({ b, color, uv });
+        vertices.push_back({ c, color, uv });
+    }
+
+    int SpriteBatch::circleSegments(float radius) {
+        constexpr float tolerance = 0.25f;
+        if (radius <= tolerance) return 8;
+        int segments = static_cast<int>(std::ceil(M_PI / std::acos(1.0f - tolerance / radius)));
+        return std::clamp(segments, 8, 128);
+    }
+
+    void SpriteBatch::drawRectangle(sf::RenderTarget& target, sf::FloatRect rect, sf::Color color) {
+        begin(target, &whiteTexture);
+        sf::Vector2f tl = rect.position;
+        sf::Vector2f br = rect.position + rect.size;
+        pushSolid(tl, { br.x, tl.y }, br, color);
+        pushSolid(tl, br, { tl.x, br.y }, color);
+    }
+
+    void SpriteBatch::drawRectangleOutline(sf::RenderTarget& target, sf::FloatRect rect, float thickness, sf::Color color) {
+        float w = rect.size.x, h = rect.size.y;
+        sf::Vector2f p = rect.position;
+        drawRectangle(target, { p, { w, thickness } }, color);
+        drawRectangle(target, { { p.x, p.y + h - thickness }, { w, thickness } }, color);
+        drawRectangle(target, { { p.x, p.y + thickness }, { thickness, h - 2 * thickness } }, color);
+        drawRectangle(target, { { p.x + w - thickness, p.y + thickness }, { thickness, h - 2 * thickness } }, color);
+    }
+
+    void SpriteBatch::drawLine(sf::RenderTarget& target, sf::Vector2f from, sf::Vector2f to, float thickness, sf::Color color) {
+        sf::Vector2f d = to - from;
+        float length = std::sqrt(d.x * d.x + d.y * d.y);
+        if (length == 0) return;
+
+        begin(target, &whiteTexture);
+        sf::Vector2f n { -d.y / length * thickness * 0.5f, d.x / length * thickness * 0.5f };
+        pushSolid(from + n, to + n, to - n, color);
+        pushSolid(from + n, to - n, from - n, color);
+    }
+
+    void SpriteBatch::drawCircle(sf::RenderTarget& target, sf::Vector2f center, float radius, sf::Color color) {
+        begin(target, &whiteTexture);
+        int segments = circleSegments(radius);
+        float step = static_cast<float>(2 * M_PI / segments);
+        sf::Vector2f previous { center.x + radius, center.y };
+        for (int i = 1; i <= segments; ++i) {
+            sf::Vector2f next { center.x + std::cos(i * step) * radius, center.y + std::sin(i * step) * radius };
+            pushSolid(center, previous, next, color);
+            previous = next;
+        }
+    }
+
+    void SpriteBatch::drawCircleOutline(sf::RenderTarget& target, sf::Vector2f center, float radius, float thickness, sf::Color color) {
+        begin(target, &whiteTexture);
+        int segments = circleSegments(radius);
+        float step = static_cast<float>(2 * M_PI / segments);
+        float inner = std::max(0.0f, radius - thickness);
+        sf::Vector2f outerPrev { center.x + radius, center.y };
+        sf::Vector2f innerPrev { center.x + inner, center.y };
+        for (int i = 1; i <= segments; ++i) {
+            sf::Vector2f dir { std::cos(i * step), std::sin(i * step) };
+            sf::Vector2f outerNext = center + dir * radius;
+            sf::Vector2f innerNext = center + dir * inner;
+            pushSolid(innerPrev, outerPrev, outerNext, color);
+            pushSolid(innerPrev, outerNext, innerNext, color);
+            outerPrev = outerNext;
+            innerPrev = innerNext;
+        }
+    }
+
+    void SpriteBatch::setBlendMode(const sf::BlendMode& mode) {
+        if (mode != blendMode) {
+            flush();
+            blendMode = mode;
+        }
+    }
+
+    void SpriteBatch::flush() {
+        if (vertices.empty() || target == nullptr) {
+            vertices.clear();
+            return;
+        }
+
+        sf::RenderStates states;
+        states.texture = texture;
+        states.shader = shader;
+        states.blendMode = blendMode;
+        CommandBuffer::get().drawTriangles(*target, vertices.data(), vertices.size(), states);
+        vertices.clear();
+    }
+}
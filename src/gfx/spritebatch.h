@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+namespace GFX {
+    // Collects textured quads into as few draws as possible. Pending quads are recorded into the command buffer
+    // whenever the target, texture, shader or blend mode changes. Anything recording into the command buffer
+    // without going through the batch must flush first.
+    class SpriteBatch {
+    public:
+        static SpriteBatch& get() {
+            static SpriteBatch batch;
+            return batch;
+        }
+
+        // Four corners in winding order, drawn with the current shader
+        void drawQuad(sf::RenderTarget& target, const sf::Texture* texture, const sf::Vertex* quad);
+
+        // Same transform order as sf::Transformable: translate, rotate (clockwise degrees), scale, then origin
+        void drawSprite(
+            sf::RenderTarget& target,
+            const sf::Texture& texture,
+            const sf::IntRect& rect,
+            sf::Vector2f position,
+            sf::Vector2f origin,
+            sf::Vector2f scale,
+            float rotation,
+            sf::Color color);
+
+        // Pre-built triangles (three vertices each) moved by offset and tinted with color
+        void drawTriangles(
+            sf::RenderTarget& target,
+            const sf::Texture* texture,
+            const sf::Vertex* triangles,
+            size_t count,
+            sf::Vector2f offset,
+            sf::Color color);
+
+        // Untextured primitives, drawn with GFX::whiteTexture so they share batches with each other
+        void drawRectangle(sf::RenderTarget& target, sf::FloatRect rect, sf::Color color);
+        void drawRectangleOutline(sf::RenderTarget& target, sf::FloatRect rect, float thickness, sf::Color color);
+        void drawLine(sf::RenderTarget& target, sf::Vector2f from, sf::Vector2f to, float thickness, sf::Color color);
+        void drawCircle(sf::RenderTarget& target, sf::Vector2f center, float radius, sf::Color color);
+        void drawCircleOutline(sf::RenderTarget& target, sf::Vector2f center, float radius, float thickness, sf::Color color);
+
+        // Fewest segments keeping a circle within a quarter pixel of round
+        static int circleSegments(float radius);
+
+        void setBlendMode(const sf::BlendMode& mode);
+        void flush();
+
+    private:
+        SpriteBatch() { vertices.reserve(6 * 1024); }
+        // Flushes when anything but the vertices differs from what is pending
+        void begin(sf::RenderTarget& target, const sf::Texture* texture);
+        void pushSolid(sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, sf::Color color);
+
+        std::vector<sf::Vertex> vertices;
+        sf::RenderTarget* target = nullptr;
+        const sf::Texture* texture = nullptr;
+        const sf::Shader* shader = nullptr;
+        sf::BlendMode blendMode = sf::BlendAlpha;
+    };
+}
@@ -1,7 +1,47 @@
+#include <charconv>
 #include <fstream>
 #include "tileset.h"
 #include "vendor/json.hpp"
 
+// Reads a "collision" block: { "solid": [ids] or "all", "slopes": { "id": [left height, right height] } }
+// Without one, every tile but the empty tile is solid.
+static void LoadTileCollision(Tileset& ts, const nlohmann::json* block) {
+    int idCount = std::max(ts.tileCount, ts.tileCountX * ts.tileCountY);
+    ts.collision.assign(std::max(idCount, 1), TileCollision { TileShape::SOLID });
+    ts.collision[0].shape = TileShape::EMPTY;
+
+    if (block == nullptr) {
+        return;
+    }
+
+    const nlohmann::json& j = *block;
+    if (j.contains("solid") && j["solid"].is_array()) {
+        for (int i = 1; i < ts.collision.size(); ++i) {
+            ts.collision[i].shape = TileShape::EMPTY;
+        }
+        for (int id : j["solid"]) {
+            if (id > 0 && id < ts.collision.size()) {
+                ts.collision[id].shape = TileShape::SOLID;
+            }
+        }
+    }
+
+    if (j.contains("slopes") && j["slopes"].is_object()) {
+        for (auto& [key, heights] : j["slopes"].items()) {
+            // Keys are tile ids, anything else (or heights that aren't two numbers) is skipped
+            int id = 0;
+            auto parsed = std::from_chars(key.data(), key.data() + key.size(), id);
+            if (parsed.ec != std::errc() || parsed.ptr != key.data() + key.size()) continue;
+            if (id <= 0 || id >= ts.collision.size() || heights.size() != 2) continue;
+            if (!heights[0].is_number() || !heights[1].is_number()) continue;
+            TileCollision& tc = ts.collision[id];
+            tc.shape = TileShape::SLOPE;
+            tc.left = heights[0].get<float>() / ts.tileHeight;
+            tc.right = heights[1].get<float>() / ts.tileHeight;
+        }
+    }
+}
+
 void TilesetManager::initializeLua(LuaState& L, const std::filesystem::path& assets) {
     TilesetManager& tsMgr = TilesetManager::get();
 
@@ -45,6 +85,21 @@ void TilesetManager::initializeLua(LuaState& L, const std::filesystem::path& ass
             ts.separationY,
             nullptr
         );
+
+        // Collision can live in the managed file or in a hand written tilesets/<name>.json next to it
+        nlohmann::json overrides;
+        auto overridePath = assets / "tilesets" / (identifier + ".json");
+        if (std::filesystem::exists(overridePath)) {
+            std::ifstream oi(overridePath);
+            overrides = nlohmann::json::parse(oi);
+        }
+        if (overrides.contains("collision")) {
+            LoadTileCollision(ts, &overrides["collision"]);
+        }
+        else {
+            LoadTileCollision(ts, j.contains("collision") ? &j["collision"] : nullptr);
+        }
+
         tsMgr.tilesets[identifier] = ts;
 
         
@@ -2,6 +2,19 @@
 
 #include "sprite.h"
 
+enum class TileShape : uint8_t {
+    EMPTY = 0,
+    SOLID = 1,
+    SLOPE = 2
+};
+
+// How a tile id collides. Slopes are solid below a floor line running from the left edge to the right edge.
+struct TileCollision {
+    TileShape shape = TileShape::EMPTY;
+    // Floor heights measured up from the tile's bottom, as a fraction of the tile height
+    float left = 0.0f, right = 0.0f;
+};
+
 class Tileset {
 public:
     int offsetX, offsetY;
@@ -11,6 +24,12 @@ public:
     int tileWidth, tileHeight;
     int padding;
     sf::Texture tex;
+    std::vector<TileCollision> collision;
+
+    const TileCollision& tileCollision(int tileId) const {
+        static const TileCollision empty {};
+        return (tileId > 0 && tileId < collision.size()) ? collision[tileId] : empty;
+    }
 };
 
 class TilesetManager {
@@ -84,7 +84,11 @@ inline double lua_tonumbertable(lua_State* L, int idx, lua_Integer n) {
     return num;
 }
 
+// Takes a { r, g, b, a } table or a color packed as 0xRRGGBBAA (see TE.gfx.color)
 inline sf::Color lua_tocolor(lua_State* L, int idx) {
+    if (lua_type(L, idx) == LUA_TNUMBER) {
+        return sf::Color(static_cast<std::uint32_t>(lua_tointeger(L, idx)));
+    }
     lua_rawgeti(L, idx, 1); uint8_t r = static_cast<std::uint8_t>(lua_tonumber(L, -1)); lua_pop(L, 1);
     lua_rawgeti(L, idx, 2); uint8_t g = static_cast<std::uint8_t>(lua_tonumber(L, -1)); lua_pop(L, 1);
     lua_rawgeti(L, idx, 3); uint8_t b = static_cast<std::uint8_t>(lua_tonumber(L, -1)); lua_pop(L, 1);
@@ -105,6 +109,18 @@ T* lua_toclass(lua_State* L, int idx) {
     return item;
 }
 
+// Reads __cpp_ptr off the table itself, never through __index. Instance tables fall back to their class through
+// __index, so a destroyed instance (whose pointer is cleared) would otherwise resolve to its class.
+template <typename T>
+T* lua_torawclass(lua_State* L, int idx) {
+    idx = lua_absindex(L, idx);
+    lua_pushstring(L, "__cpp_ptr");
+    lua_rawget(L, idx);
+        T* item = static_cast<T*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+    return item;
+}
+
 template <typename T>
 T* lua_testclass(lua_State* L, int idx, const char* mt) {
     lua_getmetatable(L, idx);     // -1: obj mt
@@ -15,6 +15,10 @@ extern "C" {
 #include "gfx/tileset.h"
 #include "gfx/shader.h"
 #include "gfx/font.h"
+#include "gfx/commandbuffer.h"
+#include "gfx/renderthread.h"
+#include "gfx/atlas.h"
+#include "gfx/canvaspool.h"
 
 #define GMC_EMBEDDED
 #define GMCONVERT_IMPLEMENTATION
@@ -212,14 +216,23 @@ int main() {
 
     refBaseline = refcount;
 
+    auto& commands = GFX::CommandBuffer::get();
+    auto& renderThread = GFX::RenderThread::get();
+    renderThread.start(*window);
+
     sf::Clock clock;
     int fps = 0, frame = 0;
     while (window->isOpen()) {
         while (const std::optional event = window->pollEvent()) {
             if (event->is<sf::Event::Closed>()) {
+                // The render thread may still be displaying the previous frame through the window
+                renderThread.stop();
                 window->close();
             }
         }
+        if (!window->isOpen()) {
+            break;
+        }
 
         game.timer.update();
         
@@ -237,12 +250,14 @@ int main() {
 
         float alpha = game.timer.getAlpha();
 
-        window->clear();
+        // Steps above overlap with the previous frame, drawing may update textures and buffers it still uses
+        renderThread.waitIdle();
+        commands.clear(*window, sf::Color::Black);
 
         const auto dispSize = window->getSize();
         sf::View view(sf::FloatRect{ { 0, 0 }, { (float)dispSize.x, (float)dispSize.y } });
         view.setCenter({ dispSize.x / 2.0f, dispSize.y / 2.0f });
-        window->setView(view);
+        commands.setView(*window, view);
 
         lua_getglobal(lua, ENGINE_ENV); // TE
             lua_getfield(lua, -1, "draw"); // Draw function, te
@@ -250,7 +265,8 @@ int main() {
                 lua_lazycall(lua, 1, 0); // TE
         lua_pop(lua, 1); // =
 
-        window->display();
+        commands.present(*window);
+        GFX::CanvasPool::get().endFrame();
 
         float delta = clock.restart().asSeconds();
         game.fps = 1.f / delta;
@@ -258,8 +274,11 @@ int main() {
         ++frame;
     }
 
+    renderThread.stop();
     lua_close(game.L);
 
     TilesetManager::get().tilesets.clear();
     GFX::sprites.clear();
+    GFX::Atlas::get().clear();
+    GFX::CanvasPool::get().clear();
 }
\ No newline at end of file
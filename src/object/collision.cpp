@@ -1,60 +1,123 @@
 #include "collision.h"
 #include <cmath>
+#include <limits>
 
-CollisionResult polygonsIntersect(const std::vector<sf::Vector2f>& polyA, const std::vector<sf::Vector2f>& polyB) {
-    if (polyA.empty() || polyB.empty()) return { false, {} }; // no collision
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define COLLISION_SSE
+#endif
 
-    float smallestOverlap = std::numeric_limits<float>::max();
-    sf::Vector2f smallestAxis;
-
-    auto getAxes = [](const std::vector<sf::Vector2f>& poly) {
-        std::vector<sf::Vector2f> axes;
-
-        for (size_t i = 0; i < poly.size(); ++i) {
-            sf::Vector2f p1 = poly[i];
-            sf::Vector2f p2 = poly[(i + 1) % poly.size()];
-            sf::Vector2f edge = p2 - p1;
-            sf::Vector2f normal(-edge.y, edge.x);
-
-            float length = std::sqrt(normal.x * normal.x + normal.y * normal.y);
-            if (length > 0) normal /= length;
-
-            axes.push_back(normal);
+OrientedBox::OrientedBox(const Quad& quad, bool axisAligned) : axisAligned(axisAligned) {
+    for (int i = 0; i < 4; ++i) {
+        xs[i] = quad[i].x;
+        ys[i] = quad[i].y;
+    }
+}
+
+OrientedBox OrientedBox::fromRect(const sf::FloatRect& rect) {
+    float l = rect.position.x;
+    float t = rect.position.y;
+    float r = l + rect.size.x;
+    float b = t + rect.size.y;
+    return OrientedBox({ sf::Vector2f { l, t }, { r, t }, { r, b }, { l, b } }, true);
+}
+
+static inline void Project(const OrientedBox& box, sf::Vector2f axis, float& outMin, float& outMax) {
+#ifdef COLLISION_SSE
+    __m128 p = _mm_add_ps(
+        _mm_mul_ps(_mm_load_ps(box.xs), _mm_set1_ps(axis.x)),
+        _mm_mul_ps(_mm_load_ps(box.ys), _mm_set1_ps(axis.y)));
+    __m128 swapped = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 mn = _mm_min_ps(p, swapped);
+    __m128 mx = _mm_max_ps(p, swapped);
+    mn = _mm_min_ps(mn, _mm_shuffle_ps(mn, mn, _MM_SHUFFLE(1, 0, 3, 2)));
+    mx = _mm_max_ps(mx, _mm_shuffle_ps(mx, mx, _MM_SHUFFLE(1, 0, 3, 2)));
+    outMin = _mm_cvtss_f32(mn);
+    outMax = _mm_cvtss_f32(mx);
+#else
+    outMin = outMax = box.xs[0] * axis.x + box.ys[0] * axis.y;
+    for (int i = 1; i < 4; ++i) {
+        float proj = box.xs[i] * axis.x + box.ys[i] * axis.y;
+        outMin = std::min(outMin, proj);
+        outMax = std::max(outMax, proj);
+    }
+#endif
+}
+
+// A box only has two unique edge directions, so two normals cover it
+static inline int GetAxes(const OrientedBox& box, sf::Vector2f* out) {
+    int count = 0;
+    for (int i = 0; i < 2; ++i) {
+        sf::Vector2f edge = { box.xs[i + 1] - box.xs[i], box.ys[i + 1] - box.ys[i] };
+        sf::Vector2f normal = { -edge.y, edge.x };
+        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y);
+        if (length > 0) {
+            out[count++] = { normal.x / length, normal.y / length };
         }
-
-        return axes;
-    };
-
-    auto project = [](const std::vector<sf::Vector2f>& poly, const sf::Vector2f& axis) {
-        float min = poly[0].x * axis.x + poly[0].y * axis.y;
-        float max = min;
-
-        for (const auto& p : poly) {
-            float proj = p.x * axis.x + p.y * axis.y;
-
-            if (proj < min) min = proj;
-            if (proj > max) max = proj;
+    }
+    return count;
+}
+
+static inline sf::Vector2f Center(const OrientedBox& box) {
+    return { (box.xs[0] + box.xs[2]) * 0.5f, (box.ys[0] + box.ys[2]) * 0.5f };
+}
+
+CollisionResult boxesIntersect(const OrientedBox& a, const OrientedBox& b) {
+    // Both unrotated, a plain rectangle overlap is enough
+    if (a.axisAligned && b.axisAligned) {
+        float aL = std::min(a.xs[0], a.xs[2]), aR = std::max(a.xs[0], a.xs[2]);
+        float aT = std::min(a.ys[0], a.ys[2]), aB = std::max(a.ys[0], a.ys[2]);
+        float bL = std::min(b.xs[0], b.xs[2]), bR = std::max(b.xs[0], b.xs[2]);
+        float bT = std::min(b.ys[0], b.ys[2]), bB = std::max(b.ys[0], b.ys[2]);
+
+        float overlapX = std::min(aR, bR) - std::max(aL, bL);
+        float overlapY = std::min(aB, bB) - std::max(aT, bT);
+        if (overlapX <= 0 || overlapY <= 0) return { false, {} };
+
+        if (overlapX < overlapY) {
+            float dir = ((aL + aR) < (bL + bR)) ? -1.0f : 1.0f;
+            return { true, { overlapX * dir, 0 } };
         }
+        float dir = ((aT + aB) < (bT + bB)) ? -1.0f : 1.0f;
+        return { true, { 0, overlapY * dir } };
+    }
 
-        return std::make_pair(min, max);
-    };
+    // Cheap rejection on the boxes' bounds before any projection
+    float aMinX, aMaxX, aMinY, aMaxY, bMinX, bMaxX, bMinY, bMaxY;
+    Project(a, { 1, 0 }, aMinX, aMaxX);
+    Project(b, { 1, 0 }, bMinX, bMaxX);
+    if (aMaxX <= bMinX || bMaxX <= aMinX) return { false, {} };
+    Project(a, { 0, 1 }, aMinY, aMaxY);
+    Project(b, { 0, 1 }, bMinY, bMaxY);
+    if (aMaxY <= bMinY || bMaxY <= aMinY) return { false, {} };
 
-    auto axes = getAxes(polyA);
-    auto axesB = getAxes(polyB);
-    axes.insert(axes.end(), axesB.begin(), axesB.end());
+    sf::Vector2f axes[4];
+    int axisCount = GetAxes(a, axes);
+    axisCount += GetAxes(b, axes + axisCount);
+    if (axisCount == 0) return { false, {} };
 
-    for (const auto& axis : axes) {
-        auto [minA, maxA] = project(polyA, axis);
-        auto [minB, maxB] = project(polyB, axis);
+    float smallestOverlap = std::numeric_limits<float>::max();
+    sf::Vector2f smallestAxis;
+
+    for (int i = 0; i < axisCount; ++i) {
+        float minA, maxA, minB, maxB;
+        Project(a, axes[i], minA, maxA);
+        Project(b, axes[i], minB, maxB);
 
         float overlap = std::min(maxA, maxB) - std::max(minA, minB);
         if (overlap <= 0) return { false, {} }; // no collision
 
         if (overlap < smallestOverlap) {
             smallestOverlap = overlap;
-            smallestAxis = axis;
+            smallestAxis = axes[i];
         }
     }
 
+    // Point the translation from b towards a
+    sf::Vector2f d = Center(a) - Center(b);
+    if (d.x * smallestAxis.x + d.y * smallestAxis.y < 0) {
+        smallestAxis = -smallestAxis;
+    }
+
     return { true, smallestAxis * smallestOverlap };
 }
\ No newline at end of file
@@ -1,10 +1,25 @@
 #pragma once
 
+#include <array>
 #include <SFML/Graphics.hpp>
 
 struct CollisionResult {
     bool intersect;
-    sf::Vector2f mtv; // min translation vector
+    sf::Vector2f mtv; // min translation vector, pushes the first box out of the second
 };
 
-CollisionResult polygonsIntersect(const std::vector<sf::Vector2f>& polyA, const std::vector<sf::Vector2f>& polyB);
\ No newline at end of file
+// Four corners of a box in winding order. Every engine collision shape is one of these.
+using Quad = std::array<sf::Vector2f, 4>;
+
+// Corners stored as separate x/y lanes so a projection is a handful of SIMD ops
+struct OrientedBox {
+    alignas(16) float xs[4];
+    alignas(16) float ys[4];
+    bool axisAligned;
+
+    OrientedBox() = default;
+    OrientedBox(const Quad& quad, bool axisAligned);
+    static OrientedBox fromRect(const sf::FloatRect& rect);
+};
+
+CollisionResult boxesIntersect(const OrientedBox& a, const OrientedBox& b);
\ No newline at end of file
@@ -48,11 +48,33 @@ bool Object::runScriptTimestep(const std::string &script, int roomIdx) {
     return true;
 }
 
-std::vector<sf::Vector2f> Object::getPoints() const {
+bool Object::runScriptCollision(const std::string& script, int roomIdx, Object* other) {
+    if (!hasTable || !other->hasTable) {
+        return false;
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, tableReference);
+    int objIdx = lua_gettop(L);
+    lua_getfield(L, objIdx, script.c_str());
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 2);
+        return false;
+    }
+    lua_pushvalue(L, objIdx);
+    lua_pushvalue(L, roomIdx);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, other->tableReference);
+    lua_lazycall(L, 3, 0);
+    lua_pop(L, 1); // pop object table
+    return true;
+}
+
+Quad Object::getPointsAt(float atX, float atY) const {
     if (imageAngle == 0) {
         sf::FloatRect rect = getRectangle();
-        return std::vector<sf::Vector2f> {
-            { rect.position.x, rect.position.y },
+        rect.position.x += atX - x;
+        rect.position.y += atY - y;
+        return {
+            sf::Vector2f { rect.position.x, rect.position.y },
             { rect.position.x + rect.size.x, rect.position.y },
             { rect.position.x + rect.size.x, rect.position.y + rect.size.y },
             { rect.position.x, rect.position.y + rect.size.y }
@@ -73,18 +95,18 @@ std::vector<sf::Vector2f> Object::getPoints() const {
         { hb.position.x, hb.position.y + hb.size.y }                // bottom-left
     };
 
-    std::vector<sf::Vector2f> transformed;
-    transformed.reserve(4);
+    Quad transformed;
 
     float rad = Deg2Rad(imageAngle);
     float cosA = std::cos(rad);
     float sinA = std::sin(rad);
 
-    for (auto& corner : unscaledCorners) {
-        sf::Vector2f scaled = { corner.x * xScale, corner.y * yScale };
+    float originX = (spriteIndex) ? spriteIndex->originX : 0;
+    float originY = (spriteIndex) ? spriteIndex->originY : 0;
+
+    for (int i = 0; i < 4; ++i) {
+        sf::Vector2f scaled = { unscaledCorners[i].x * xScale, unscaledCorners[i].y * yScale };
 
-        float originX = (spriteIndex) ? spriteIndex->originX : 0;
-        float originY = (spriteIndex) ? spriteIndex->originY : 0;
         scaled.x -= originX * xScale;
         scaled.y -= originY * yScale;
 
@@ -93,15 +115,298 @@ std::vector<sf::Vector2f> Object::getPoints() const {
             scaled.x * sinA + scaled.y * cosA
         };
 
-        rotated.x += x;
-        rotated.y += y;
+        rotated.x += atX;
+        rotated.y += atY;
 
-        transformed.push_back(rotated);
+        transformed[i] = rotated;
     }
 
     return transformed;
 }
 
+sf::FloatRect Object::getBroadphaseRect() const {
+    if (!maskIndex && !spriteIndex) {
+        return { { x, y }, { 0, 0 } };
+    }
+
+    if (imageAngle == 0) {
+        return getRectangle();
+    }
+
+    auto points = getPoints();
+    sf::Vector2f min = points[0];
+    sf::Vector2f max = points[0];
+    for (auto& p : points) {
+        min.x = std::min(min.x, p.x);
+        min.y = std::min(min.y, p.y);
+        max.x = std::max(max.x, p.x);
+        max.y = std::max(max.y, p.y);
+    }
+    return { min, max - min };
+}
+
+void Object::boundsChanged() {
+    if (gridEntry.grid != nullptr) {
+        gridEntry.grid->update(this);
+    }
+}
+
+// A rectangle snapped to whole world pixels
+struct PixelRect {
+    int left, top, right, bottom;
+};
+
+static const GFX::Sprite* CollisionSprite(const Object* o) {
+    return (o->maskIndex) ? o->maskIndex : o->spriteIndex;
+}
+
+static const GFX::Sprite::Mask* CollisionMask(const Object* o) {
+    auto spr = CollisionSprite(o);
+    return (spr && spr->precise) ? spr->frameMask(o->imageIndex) : nullptr;
+}
+
+// Unrotated and unscaled, so every mask pixel lands on exactly one world pixel
+static bool IsPixelAligned(const Object* o) {
+    return o->imageAngle == 0 && o->xScale == 1 && o->yScale == 1;
+}
+
+static PixelRect ToPixels(const sf::FloatRect& rect) {
+    return {
+        static_cast<int>(std::floor(rect.position.x)),
+        static_cast<int>(std::floor(rect.position.y)),
+        static_cast<int>(std::ceil(rect.position.x + rect.size.x)),
+        static_cast<int>(std::ceil(rect.position.y + rect.size.y))
+    };
+}
+
+// Where the whole frame of a pixel aligned instance sits in the world
+static PixelRect FramePixels(const Object* o, float atX, float atY) {
+    auto spr = CollisionSprite(o);
+    int left = static_cast<int>(std::floor(atX - spr->originX));
+    int top = static_cast<int>(std::floor(atY - spr->originY));
+    return { left, top, left + spr->width, top + spr->height };
+}
+
+// Reads up to 64 bits of a row starting at a bit offset, anything past the row reads as zero
+static inline uint64_t ReadBits(const uint64_t* row, int wordsPerRow, int offset, int count) {
+    int word = offset >> 6;
+    int shift = offset & 63;
+    uint64_t bits = row[word] >> shift;
+    if (shift != 0 && word + 1 < wordsPerRow) {
+        bits |= row[word + 1] << (64 - shift);
+    }
+    if (count < 64) {
+        bits &= (uint64_t(1) << count) - 1;
+    }
+    return bits;
+}
+
+static bool MasksOverlap(const GFX::Sprite::Mask& a, const PixelRect& aFrame, const GFX::Sprite::Mask& b, const PixelRect& bFrame) {
+    int left = std::max(aFrame.left, bFrame.left);
+    int top = std::max(aFrame.top, bFrame.top);
+    int right = std::min(aFrame.right, bFrame.right);
+    int bottom = std::min(aFrame.bottom, bFrame.bottom);
+
+    for (int y = top; y < bottom; ++y) {
+        const uint64_t* rowA = a.row(y - aFrame.top);
+        const uint64_t* rowB = b.row(y - bFrame.top);
+        for (int x = left; x < right; x += 64) {
+            int count = std::min(64, right - x);
+            uint64_t bitsA = ReadBits(rowA, a.wordsPerRow, x - aFrame.left, count);
+            if (bitsA == 0) continue;
+            if (bitsA & ReadBits(rowB, b.wordsPerRow, x - bFrame.left, count)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool MaskTouchesRect(const GFX::Sprite::Mask& mask, const PixelRect& frame, const PixelRect& rect) {
+    int left = std::max(frame.left, rect.left);
+    int top = std::max(frame.top, rect.top);
+    int right = std::min(frame.right, rect.right);
+    int bottom = std::min(frame.bottom, rect.bottom);
+
+    for (int y = top; y < bottom; ++y) {
+        const uint64_t* row = mask.row(y - frame.top);
+        for (int x = left; x < right; x += 64) {
+            if (ReadBits(row, mask.wordsPerRow, x - frame.left, std::min(64, right - x))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Maps a world point back into the collision sprite, the inverse of getRectangle / getPointsAt
+static bool SolidAt(const Object* o, float atX, float atY, float wx, float wy) {
+    auto spr = CollisionSprite(o);
+    const sf::FloatRect& hb = spr->hitbox;
+    float lx, ly;
+
+    if (o->imageAngle == 0) {
+        sf::FloatRect rect = o->getRectangle();
+        if (rect.size.x <= 0 || rect.size.y <= 0) return false;
+        float u = (wx - (rect.position.x + atX - o->x)) / rect.size.x;
+        float v = (wy - (rect.position.y + atY - o->y)) / rect.size.y;
+        if (u < 0 || u >= 1 || v < 0 || v >= 1) return false;
+        if (o->xScale < 0) u = 1.0f - u;
+        if (o->yScale < 0) v = 1.0f - v;
+        lx = hb.position.x + u * hb.size.x;
+        ly = hb.position.y + v * hb.size.y;
+    }
+    else {
+        if (o->xScale == 0 || o->yScale == 0) return false;
+        float rad = Deg2Rad(o->imageAngle);
+        float cosA = std::cos(rad);
+        float sinA = std::sin(rad);
+        float dx = wx - atX;
+        float dy = wy - atY;
+        float originX = (o->spriteIndex) ? o->spriteIndex->originX : 0;
+        float originY = (o->spriteIndex) ? o->spriteIndex->originY : 0;
+        lx = (dx * cosA + dy * sinA) / o->xScale + originX;
+        ly = (-dx * sinA + dy * cosA) / o->yScale + originY;
+        if (lx < hb.position.x || lx >= hb.position.x + hb.size.x ||
+            ly < hb.position.y || ly >= hb.position.y + hb.size.y) {
+            return false;
+        }
+    }
+
+    auto mask = CollisionMask(o);
+    if (!mask) return true;
+
+    int px = static_cast<int>(std::floor(lx));
+    int py = static_cast<int>(std::floor(ly));
+    if (px < 0 || py < 0 || px >= spr->width || py >= spr->height) return false;
+    return mask->test(px, py);
+}
+
+// Tests pixel centres one by one, for shapes that are rotated or scaled
+template <typename F>
+static bool AnyPixel(const sf::FloatRect& area, F&& solid) {
+    PixelRect px = ToPixels(area);
+    for (int y = px.top; y < px.bottom; ++y) {
+        for (int x = px.left; x < px.right; ++x) {
+            if (solid(x + 0.5f, y + 0.5f)) return true;
+        }
+    }
+    return false;
+}
+
+bool Object::isPrecise() const {
+    return CollisionMask(this) != nullptr;
+}
+
+bool Object::preciseMeeting(float atX, float atY, const Object* other) const {
+    auto mask = CollisionMask(this);
+    auto otherMask = CollisionMask(other);
+    if (!mask && !otherMask) return true;
+
+    bool aligned = imageAngle == 0 && other->imageAngle == 0 &&
+        (!mask || IsPixelAligned(this)) && (!otherMask || IsPixelAligned(other));
+    if (aligned) {
+        if (mask && otherMask) {
+            return MasksOverlap(*mask, FramePixels(this, atX, atY), *otherMask, FramePixels(other, other->x, other->y));
+        }
+        if (mask) {
+            return MaskTouchesRect(*mask, FramePixels(this, atX, atY), ToPixels(other->getRectangle()));
+        }
+        sf::FloatRect rect = getRectangle();
+        rect.position.x += atX - x;
+        rect.position.y += atY - y;
+        return MaskTouchesRect(*otherMask, FramePixels(other, other->x, other->y), ToPixels(rect));
+    }
+
+    sf::FloatRect bounds = getBroadphaseRect();
+    bounds.position.x += atX - x;
+    bounds.position.y += atY - y;
+    auto overlap = bounds.findIntersection(other->getBroadphaseRect());
+    if (!overlap.has_value()) return false;
+
+    return AnyPixel(*overlap, [&](float wx, float wy) {
+        return SolidAt(this, atX, atY, wx, wy) && SolidAt(other, other->x, other->y, wx, wy);
+    });
+}
+
+bool Object::raycast(sf::Vector2f from, sf::Vector2f to, float& t, sf::Vector2f& normal) const {
+    if (!hasMask()) return false;
+
+    // Slab test in the box's own axes, which works for any rotation or mirroring
+    Quad q = getPoints();
+    sf::Vector2f axes[2] = { q[1] - q[0], q[3] - q[0] };
+    sf::Vector2f d = to - from;
+    sf::Vector2f rel = from - q[0];
+
+    float tMin = 0.0f, tMax = 1.0f;
+    sf::Vector2f entryNormal {};
+    for (auto& axis : axes) {
+        float lenSq = axis.x * axis.x + axis.y * axis.y;
+        if (lenSq == 0) return false;
+
+        float start = (rel.x * axis.x + rel.y * axis.y) / lenSq;
+        float speed = (d.x * axis.x + d.y * axis.y) / lenSq;
+        if (speed == 0) {
+            if (start < 0 || start > 1) return false;
+            continue;
+        }
+
+        float len = std::sqrt(lenSq);
+        float t1 = -start / speed;
+        float t2 = (1.0f - start) / speed;
+        sf::Vector2f n = { -axis.x / len, -axis.y / len };
+        if (t1 > t2) {
+            std::swap(t1, t2);
+            n = -n;
+        }
+        if (t1 > tMin) {
+            tMin = t1;
+            entryNormal = n;
+        }
+        tMax = std::min(tMax, t2);
+        if (tMin > tMax) return false;
+    }
+
+    if (!isPrecise()) {
+        t = tMin;
+        normal = entryNormal;
+        return true;
+    }
+
+    // Walk the part inside the box half a pixel at a time
+    float length = std::sqrt(d.x * d.x + d.y * d.y);
+    float step = (length > 0) ? 0.5f / length : 1.0f;
+    for (float at = tMin; at <= tMax; at += step) {
+        if (SolidAt(this, x, y, from.x + d.x * at, from.y + d.y * at)) {
+            t = at;
+            if (at == tMin) {
+                normal = entryNormal;
+            }
+            else {
+                normal = (length > 0) ? sf::Vector2f { -d.x / length, -d.y / length } : sf::Vector2f {};
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Object::preciseRectMeeting(const sf::FloatRect& rect) const {
+    auto mask = CollisionMask(this);
+    if (!mask) return true;
+
+    if (IsPixelAligned(this)) {
+        return MaskTouchesRect(*mask, FramePixels(this, x, y), ToPixels(rect));
+    }
+
+    auto overlap = rect.findIntersection(getBroadphaseRect());
+    if (!overlap.has_value()) return false;
+
+    return AnyPixel(*overlap, [&](float wx, float wy) {
+        return SolidAt(this, x, y, wx, wy);
+    });
+}
+
 const bool Object::extends(Object* BaseObject) const {
     if (BaseObject == nullptr) return false;
     if (self == BaseObject) return true;
@@ -125,6 +430,53 @@ const bool Object::extends(Object* BaseObject) const {
     return false;
 }
 
+bool Object::intersectsView(const sf::FloatRect& viewRect, float alpha) const {
+    // Nothing to measure, so let it through
+    if (!spriteIndex) {
+        return true;
+    }
+
+    float interpX = lerp(xPrevRender, x, alpha);
+    float interpY = lerp(yPrevRender, y, alpha);
+
+    float left = -spriteIndex->originX * xScale;
+    float top = -spriteIndex->originY * yScale;
+    float right = left + spriteIndex->width * xScale;
+    float bottom = top + spriteIndex->height * yScale;
+
+    float minX, minY, maxX, maxY;
+    if (imageAngle == 0) {
+        minX = std::min(left, right);
+        maxX = std::max(left, right);
+        minY = std::min(top, bottom);
+        maxY = std::max(top, bottom);
+    }
+    else {
+        // Sprites are drawn with the angle negated, see GFX::Sprite::draw
+        float rad = Deg2Rad(-imageAngle);
+        float cosA = std::cos(rad);
+        float sinA = std::sin(rad);
+        sf::Vector2f corners[4] = {
+            { left, top }, { right, top }, { right, bottom }, { left, bottom }
+        };
+        minX = minY = std::numeric_limits<float>::max();
+        maxX = maxY = std::numeric_limits<float>::lowest();
+        for (auto& c : corners) {
+            float rx = c.x * cosA - c.y * sinA;
+            float ry = c.x * sinA + c.y * cosA;
+            minX = std::min(minX, rx);
+            maxX = std::max(maxX, rx);
+            minY = std::min(minY, ry);
+            maxY = std::max(maxY, ry);
+        }
+    }
+
+    return interpX + maxX >= viewRect.position.x &&
+        interpX + minX <= viewRect.position.x + viewRect.size.x &&
+        interpY + maxY >= viewRect.position.y &&
+        interpY + minY <= viewRect.position.y + viewRect.size.y;
+}
+
 void Object::draw(Room *room, float alpha) {
     if (!spriteIndex) {
         return;
@@ -135,6 +487,23 @@ void Object::draw(Room *room, float alpha) {
 	spriteIndex->draw(*Game::get().getRenderTarget(), { interpX, interpY }, imageIndex, { xScale, yScale }, sf::Color::White, imageAngle);
 }
 
+std::unique_ptr<Object> ObjectManager::acquireInstance(const Object& original) {
+    if (instancePool.empty()) {
+        return std::make_unique<Object>(original);
+    }
+    std::unique_ptr<Object> o = std::move(instancePool.back());
+    instancePool.pop_back();
+    *o = original;
+    return o;
+}
+
+void ObjectManager::releaseInstance(std::unique_ptr<Object> instance) {
+    if (instance->kind != InstanceKind::INSTANCE || instancePool.size() >= maxPooledInstances) {
+        return;
+    }
+    instancePool.push_back(std::move(instance));
+}
+
 void ObjectManager::registerObject(const std::string &mapIdentifier, int luaRegistryRef, Object *innerUserdataPointer) {
     tilemapObjects[mapIdentifier] = { innerUserdataPointer, luaRegistryRef };
 }
@@ -246,6 +615,8 @@ int ObjectCreateLua(lua_State* L, bool OLDARG) {
                 }
             }
             o->visible = j["visible"];
+            o->collisionLayer = j.value("collision_layer", o->collisionLayer);
+            o->collisionMask = j.value("collision_mask", o->collisionMask);
             LoadDefaultProperties(L, j["properties"], o);
         }
     }
@@ -287,20 +658,43 @@ int ObjectIsA(lua_State* L) {
     return 0;
 }
 
+// Destroyed instances lose their pointer, a stale table errors instead of reaching a recycled instance
+static Object* ToInstance(lua_State* L, int idx) {
+    Object* o = lua_torawclass<Object>(L, idx);
+    if (o == nullptr) {
+        luaL_error(L, "instance has been destroyed");
+    }
+    return o;
+}
+
 #define MAKEGETSET(val, type) \
 static int set_##val(lua_State* L) { \
-    Object* o = lua_toclass<Object>(L, 1); \
+    Object* o = ToInstance(L, 1); \
+    o->val = lua_to##type(L, 3); \
+    return 0; \
+} \
+static int get_##val(lua_State* L) { \
+    Object* o = ToInstance(L, 1); \
+    lua_push##type(L, o->val); \
+    return 1; \
+}
+
+// Same as above, for fields that move the collision shape
+#define MAKEGETSETBOUNDS(val, type) \
+static int set_##val(lua_State* L) { \
+    Object* o = ToInstance(L, 1); \
     o->val = lua_to##type(L, 3); \
+    o->boundsChanged(); \
     return 0; \
 } \
 static int get_##val(lua_State* L) { \
-    Object* o = lua_toclass<Object>(L, 1); \
+    Object* o = ToInstance(L, 1); \
     lua_push##type(L, o->val); \
     return 1; \
 }
 
-MAKEGETSET(x, number)
-MAKEGETSET(y, number)
+MAKEGETSETBOUNDS(x, number)
+MAKEGETSETBOUNDS(y, number)
 MAKEGETSET(xPrev, number)
 MAKEGETSET(yPrev, number)
 MAKEGETSET(xPrevRender, number)
@@ -309,13 +703,34 @@ MAKEGETSET(xspd, number)
 MAKEGETSET(yspd, number)
 MAKEGETSET(imageIndex, number)
 MAKEGETSET(imageSpeed, number)
-MAKEGETSET(imageAngle, number)
+MAKEGETSETBOUNDS(imageAngle, number)
 MAKEGETSET(depth, integer)
 MAKEGETSET(incrementImageSpeed, boolean)
-MAKEGETSET(active, boolean)
+MAKEGETSET(cullScriptDraw, boolean)
 MAKEGETSET(visible, boolean)
-MAKEGETSET(xScale, number)
-MAKEGETSET(yScale, number)
+MAKEGETSET(collisionLayer, integer)
+MAKEGETSET(collisionMask, integer)
+MAKEGETSETBOUNDS(xScale, number)
+MAKEGETSETBOUNDS(yScale, number)
+
+static int get_active(lua_State* L) {
+    Object* o = ToInstance(L, 1);
+    lua_pushboolean(L, o->active);
+    return 1;
+}
+
+static int set_active(lua_State* L) {
+    Object* o = ToInstance(L, 1);
+    bool active = lua_toboolean(L, 3);
+    // Room instances move in and out of the room's active set
+    if (o->MyReference.room != nullptr) {
+        o->MyReference.room->setInstanceActive(o, active);
+    }
+    else {
+        o->active = active;
+    }
+    return 0;
+}
 
 void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &assets) {
     static const luaL_Reg getters[] = {
@@ -333,11 +748,14 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
         { "depth",                          get_depth },
         { "increment_image_speed",          get_incrementImageSpeed },
         { "active",                         get_active },
+        { "cull_draw",                      get_cullScriptDraw },
+        { "collision_layer",                get_collisionLayer },
+        { "collision_mask",                 get_collisionMask },
         { "visible",                        get_visible },
         { "image_xscale",                   get_xScale },
         { "image_yscale",                   get_yScale },
         { "sprite_index",                   [](lua_State* L) -> int {
-                                                Object* o = lua_toclass<Object>(L, 1);
+                                                Object* o = ToInstance(L, 1);
                                                 if (!o->spriteIndex) {
                                                     lua_pushnil(L);
                                                     return 1;
@@ -346,7 +764,7 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
                                                 return 1;
                                             } },
         { "mask_index",                     [](lua_State* L) -> int {
-                                                Object* o = lua_toclass<Object>(L, 1);
+                                                Object* o = ToInstance(L, 1);
                                                 if (!o->maskIndex) {
                                                     lua_pushnil(L);
                                                     return 1;
@@ -372,16 +790,21 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
         { "increment_image_speed",          set_incrementImageSpeed },
         { "visible",                        set_visible },
         { "active",                         set_active },
+        { "cull_draw",                      set_cullScriptDraw },
+        { "collision_layer",                set_collisionLayer },
+        { "collision_mask",                 set_collisionMask },
         { "image_xscale",                   set_xScale },
         { "image_yscale",                   set_yScale },
         { "sprite_index",                   [](lua_State* L) -> int {
-                                                Object* o = lua_toclass<Object>(L, 1);
+                                                Object* o = ToInstance(L, 1);
                                                 o->spriteIndex = lua_toclass<GFX::Sprite>(L, 3);
+                                                o->boundsChanged();
                                                 return 0;
                                             } },
         { "mask_index",                     [](lua_State* L) -> int {
-                                                Object* o = lua_toclass<Object>(L, 1);
+                                                Object* o = ToInstance(L, 1);
                                                 o->maskIndex = lua_toclass<GFX::Sprite>(L, 3);
+                                                o->boundsChanged();
                                                 return 0;
                                             } },
         { NULL,                             NULL}
@@ -397,6 +820,37 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
         });
         lua_setfield(L, -2, "object_create");
 
+        // class a, class b
+        // Instances of each get collision_<other class> events (self, room, other) while they overlap
+        lua_pushcfunction(L, [](lua_State* L) -> int {
+            Object* a = lua_toclass<Object>(L, 1);
+            Object* b = lua_toclass<Object>(L, 2);
+            if (a == nullptr || b == nullptr) {
+                return luaL_error(L, "collision_pair expects two classes");
+            }
+            a = a->self;
+            b = b->self;
+
+            auto& pairs = ObjectManager::get().collisionPairs;
+            for (auto& pair : pairs) {
+                if ((pair.a == a && pair.b == b) || (pair.a == b && pair.b == a)) {
+                    return 0;
+                }
+            }
+            // A side whose other class has no name gets no event, there'd be nothing to call it
+            pairs.push_back({ a, b,
+                b->identifier.empty() ? std::string() : "collision_" + b->identifier,
+                a->identifier.empty() ? std::string() : "collision_" + a->identifier });
+            return 0;
+        });
+        lua_setfield(L, -2, "collision_pair");
+
+        lua_pushcfunction(L, [](lua_State* L) -> int {
+            ObjectManager::get().collisionPairs.clear();
+            return 0;
+        });
+        lua_setfield(L, -2, "collision_pairs_clear");
+
         luaL_newmetatable(L, "Object");
             // Get
             // 1: object, 2: key
@@ -500,7 +954,7 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
             lua_setfield(L, -2, "is_a");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 float left = o->getBboxLeft();
                 lua_pushnumber(L, left);
                 return 1;
@@ -508,44 +962,47 @@ void ObjectManager::initializeLua(LuaState& L, const std::filesystem::path &asse
             lua_setfield(L, -2, "bbox_left");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 lua_pushnumber(L, o->bboxTop());
                 return 1;
             });
             lua_setfield(L, -2, "bbox_top");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 lua_pushnumber(L, o->bboxRight());
                 return 1;
             });
             lua_setfield(L, -2, "bbox_right");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 lua_pushnumber(L, o->bboxBottom());
                 return 1;
             });
             lua_setfield(L, -2, "bbox_bottom");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 o->y = o->yPrev = o->yPrevRender = luaL_checknumber(L, 2);
+                o->boundsChanged();
                 return 0;
             });
             lua_setfield(L, -2, "force_y");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 o->x = o->xPrev = o->xPrevRender = luaL_checknumber(L, 2);
+                o->boundsChanged();
                 return 0;
             });
             lua_setfield(L, -2, "force_x");
 
             lua_pushcfunction(L, [](lua_State* L) -> int {
-                Object* o = lua_toclass<Object>(L, 1);
+                Object* o = ToInstance(L, 1);
                 o->x = o->xPrev = o->xPrevRender = luaL_checknumber(L, 2);
                 o->y = o->yPrev = o->yPrevRender = luaL_checknumber(L, 3);
+                o->boundsChanged();
                 return 0;
             });
             lua_setfield(L, -2, "force_position");
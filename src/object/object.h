@@ -8,6 +8,8 @@
 #include "../gfx/sprite.h"
 #include "luainc.h"
 #include "util/mathhelper.h"
+#include "room/spatialgrid.h"
+#include "collision.h"
 #include "objectid.h"
 
 class Object;
@@ -28,8 +30,18 @@ enum class PropertyType {
 
 int ObjectCreateLua(lua_State* L, bool luaOwned);
 
+// What an entry in a room's instance list is, without needing a dynamic_cast
+enum class InstanceKind : uint8_t {
+    INSTANCE = 0,
+    BACKGROUND = 1,
+    TILEMAP = 2
+};
+
 class Object {
 public:
+    static constexpr uint32_t allCollisionLayers = 0xFFFFFFFF;
+
+    InstanceKind kind = InstanceKind::INSTANCE;
     int depth = 0;
     bool visible = true;
 
@@ -37,6 +49,7 @@ public:
         ObjectId id;
         ObjectId roomId;
         Object* object;
+        Room* room = nullptr;
     };
     Reference MyReference;
 
@@ -56,6 +69,17 @@ public:
     float imageAngle = 0.0f;
     bool incrementImageSpeed = false;
     bool active = true;
+    // Layers this instance is on, and the layers its own queries look at by default
+    uint32_t collisionLayer = 1;
+    uint32_t collisionMask = allCollisionLayers;
+    // Lets the room skip the Lua draw event when the instance is off-view.
+    bool cullScriptDraw = false;
+    // Whether the room currently keeps this instance in its deactivated list
+    bool storedInactive = false;
+    // Queued in the room's delete queue, guards against queueing twice
+    bool pendingDestroy = false;
+
+    SpatialGrid::Entry gridEntry {};
 
     GFX::Sprite* spriteIndex = nullptr;
     GFX::Sprite* maskIndex = nullptr;
@@ -68,7 +92,7 @@ public:
 
     Object(LuaState L) : L(L) {}
 
-    ~Object () = default;
+    virtual ~Object () = default;
 
     // Retrieve the left side of the bounding box with scaling applied.
     const inline float getBboxLeft() const {
@@ -128,18 +152,59 @@ public:
         return rect;
     }
 
+    // Axis aligned bounds of the collision shape (rotation included), or the origin point without a mask.
+    sf::FloatRect getBroadphaseRect() const;
+
+    // Must be called after changing anything that moves the collision shape, keeps the room's grid in sync.
+    void boundsChanged();
+
     bool runScriptTimestep(const std::string& script, int roomIdx);
     bool runScriptDraw(const std::string& script, int roomIdx, float alpha);
+    bool runScriptCollision(const std::string& script, int roomIdx, Object* other);
+
+    bool hasMask() const { return maskIndex != nullptr || spriteIndex != nullptr; }
+    bool inLayers(uint32_t mask) const { return (collisionLayer & mask) != 0; }
+
+    // Corners of the collision box, as if the instance was placed at the given position
+    Quad getPointsAt(float atX, float atY) const;
+    Quad getPoints() const { return getPointsAt(x, y); }
+    OrientedBox getBoxAt(float atX, float atY) const { return OrientedBox(getPointsAt(atX, atY), imageAngle == 0); }
+    OrientedBox getBox() const { return getBoxAt(x, y); }
+
+    // Whether either the mask or sprite asks for per-pixel collision
+    bool isPrecise() const;
+    // Per-pixel check that runs after the boxes are known to touch. Imprecise shapes count as solid inside their box.
+    bool preciseMeeting(float atX, float atY, const Object* other) const;
+    bool preciseRectMeeting(const sf::FloatRect& rect) const;
+    // First point of the collision shape along the segment, as a fraction of its length
+    bool raycast(sf::Vector2f from, sf::Vector2f to, float& t, sf::Vector2f& normal) const;
 
-    std::vector<sf::Vector2f> getPoints() const;
     const bool extends(Object* o) const;
 
+    // Whether the sprite, as drawn at the interpolated position, touches the view rectangle.
+    virtual bool intersectsView(const sf::FloatRect& viewRect, float alpha) const;
     virtual void draw(Room* room, float alpha);
 };
 
 class ObjectManager {
 public:
     std::unordered_map<std::string, std::pair<Object*, int>> tilemapObjects;
+
+    // Destroyed instances are kept around and reused by the next instance created
+    static constexpr size_t maxPooledInstances = 4096;
+    std::vector<std::unique_ptr<Object>> instancePool;
+    std::unique_ptr<Object> acquireInstance(const Object& original);
+    void releaseInstance(std::unique_ptr<Object> instance);
+
+    // Classes whose overlapping instances get each other's collision_<Class> event after step
+    struct CollisionPair {
+        Object* a;
+        Object* b;
+        std::string eventA; // run on instances of a, named after b
+        std::string eventB;
+    };
+    std::vector<CollisionPair> collisionPairs;
+
     static ObjectManager& get() {
         static ObjectManager om;
         return om;
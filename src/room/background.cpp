@@ -1,5 +1,6 @@
 #include "room.h"
 #include "game.h"
+#include "gfx/spritebatch.h"
 
 void Background::draw(Room* room, float alpha) {
     auto& game = Game::get();
@@ -10,14 +11,7 @@ void Background::draw(Room* room, float alpha) {
     float x = cx - 1;
     float y = cy - 1;
 
-    sf::Shader* shader = Game::get().currentShader;
-    if (spriteIndex && spriteIndex->sprite) {
-        sf::Sprite* spr = spriteIndex->sprite.get();
-        spr->setScale({ 1, 1 });
-        spr->setOrigin({ 0, 0 });
-        spr->setColor(color);
-        spr->setRotation(sf::degrees(0));
-        spr->setColor({ 255, 255, 255, 255 });
+    if (spriteIndex && spriteIndex->ensureLoaded()) {
         float parallax = xspd;
         float parallaxY = yspd;
         float x = (cx * parallax) + this->x;
@@ -28,19 +22,28 @@ void Background::draw(Room* room, float alpha) {
         timesOver = floorf((cy * (1.0f - parallaxY)) / spriteIndex->height);
         y += (spriteIndex->height) * timesOver;
 
-        for (int i = -1; i <= 1; ++i) {
-            for (int j = -1; j <= 1; ++j) {
-                if (!tiledY && j != 0) continue;
-                spr->setPosition({ floorf(x) + (i * spriteIndex->width), floorf(y) + (j * spriteIndex->height) });
-                Game::get().getRenderTarget()->draw(*spr, shader);
-            }
+        x = floorf(x);
+        y = floorf(y);
+
+        // One quad over the view with texture coordinates relative to the tile origin, the texture wraps the rest
+        float left = cx - 1;
+        float right = cx + room->view.width + 1;
+        float top = tiledY ? cy - 1 : y;
+        float bottom = tiledY ? cy + room->view.height + 1 : y + spriteIndex->height;
+
+        sf::Vertex quad[4];
+        quad[0].position = { left, top };
+        quad[1].position = { right, top };
+        quad[2].position = { right, bottom };
+        quad[3].position = { left, bottom };
+        for (auto& v : quad) {
+            v.texCoords = { v.position.x - x, v.position.y - y };
         }
+
+        GFX::SpriteBatch::get().drawQuad(*Game::get().getRenderTarget(), &spriteIndex->repeatedTexture(), quad);
     }
     else {
-        sf::RectangleShape rs({ room->view.width + 2, room->view.height + 2 });
-        rs.setTexture(&GFX::whiteTexture);
-        rs.setFillColor(color);
-        rs.setPosition({ x, y });
-        Game::get().getRenderTarget()->draw(rs, shader);
+        sf::FloatRect rect { { x, y }, { room->view.width + 2, room->view.height + 2 } };
+        GFX::SpriteBatch::get().drawRectangle(*Game::get().getRenderTarget(), rect, color);
     }
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "layercache.h"
+#include "room.h"
+#include "game.h"
+#include "gfx/spritebatch.h"
+#include "gfx/commandbuffer.h"
+#include "gfx/renderthread.h"
+
+LayerCache::~LayerCache() {
+    // Pages may still be sampled by a frame in flight
+    GFX::RenderThread::get().waitIdle();
+}
+
+bool LayerCache::matches(const std::vector<Tilemap*>& run) const {
+    if (run != layers) return false;
+    for (size_t i = 0; i < run.size(); ++i) {
+        if (run[i]->version != versions[i]) return false;
+    }
+    return true;
+}
+
+void LayerCache::reset(const std::vector<Tilemap*>& run, int roomWidth, int roomHeight) {
+    layers = run;
+    versions.clear();
+    for (auto* layer : run) {
+        versions.push_back(layer->version);
+    }
+
+    if (roomWidth != width || roomHeight != height) {
+        GFX::RenderThread::get().waitIdle();
+        width = roomWidth;
+        height = roomHeight;
+        pageCountX = (width + pageSize - 1) / pageSize;
+        pageCountY = (height + pageSize - 1) / pageSize;
+        pages.clear();
+        pages.resize(static_cast<size_t>(pageCountX) * pageCountY);
+    }
+
+    for (auto& page : pages) {
+        page.dirty = true;
+    }
+}
+
+void LayerCache::renderPage(Room* room, int px, int py) {
+    Page& page = pages[px + py * pageCountX];
+    float x = static_cast<float>(px * pageSize);
+    float y = static_cast<float>(py * pageSize);
+    unsigned int w = std::min(pageSize, width - px * pageSize);
+    unsigned int h = std::min(pageSize, height - py * pageSize);
+
+    if (!page.canvas) {
+        GFX::RenderThread::get().waitIdle();
+        page.canvas = std::make_unique<GFX::Canvas>();
+        page.canvas->base = false;
+        page.canvas->rt = sf::RenderTexture(sf::Vector2u { w, h });
+    }
+
+    // Layers draw into the page like into any other canvas, without whatever shader is bound
+    auto& game = Game::get();
+    GFX::Canvas* previousRenderer = game.currentRenderer;
+    sf::Shader* previousShader = game.currentShader;
+    game.currentRenderer = page.canvas.get();
+    game.currentShader = nullptr;
+
+    auto& commands = GFX::CommandBuffer::get();
+    GFX::SpriteBatch::get().flush();
+    commands.clear(page.canvas->rt, sf::Color::Transparent);
+    page.canvas->setRenderPosition(x, y);
+    for (auto* layer : layers) {
+        layer->drawVertices(room, 0, x, y, static_cast<float>(w), static_cast<float>(h));
+    }
+    commands.display(page.canvas->rt);
+
+    game.currentRenderer = previousRenderer;
+    game.currentShader = previousShader;
+    page.dirty = false;
+}
+
+void LayerCache::draw(Room* room, sf::RenderTarget& target, const sf::FloatRect& viewRect) {
+    if (pages.empty()) return;
+
+    int firstX = std::max(0, static_cast<int>(std::floor(viewRect.position.x / pageSize)));
+    int firstY = std::max(0, static_cast<int>(std::floor(viewRect.position.y / pageSize)));
+    int lastX = std::min(pageCountX - 1, static_cast<int>(std::floor((viewRect.position.x + viewRect.size.x) / pageSize)));
+    int lastY = std::min(pageCountY - 1, static_cast<int>(std::floor((viewRect.position.y + viewRect.size.y) / pageSize)));
+
+    auto& batch = GFX::SpriteBatch::get();
+    for (int py = firstY; py <= lastY; ++py) {
+        for (int px = firstX; px <= lastX; ++px) {
+            Page& page = pages[px + py * pageCountX];
+            if (page.dirty) {
+                renderPage(room, px, py);
+            }
+
+            const sf::Texture& texture = page.canvas->rt.getTexture();
+            sf::IntRect rect({}, sf::Vector2i(texture.getSize()));
+            sf::Vector2f position { static_cast<float>(px * pageSize), static_cast<float>(py * pageSize) };
+            batch.drawSprite(target, texture, rect, position, { 0, 0 }, { 1, 1 }, 0, sf::Color::White);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "gfx/sprite.h"
+
+class Room;
+class Tilemap;
+
+// Pre-renders a run of tilemaps adjacent in draw order into pages of render textures, so drawing them is one
+// quad per visible page. Pages are rendered on first sight and again after any of the layers changes.
+class LayerCache {
+public:
+    static constexpr int pageSize = 1024;
+
+    ~LayerCache();
+
+    // Whether the cache was built for exactly these layers, as they are now
+    bool matches(const std::vector<Tilemap*>& run) const;
+    void reset(const std::vector<Tilemap*>& run, int roomWidth, int roomHeight);
+    void draw(Room* room, sf::RenderTarget& target, const sf::FloatRect& viewRect);
+
+private:
+    struct Page {
+        std::unique_ptr<GFX::Canvas> canvas;
+        bool dirty = true;
+    };
+
+    std::vector<Tilemap*> layers;
+    std::vector<unsigned int> versions;
+    std::vector<Page> pages;
+    int width = 0, height = 0;
+    int pageCountX = 0, pageCountY = 0;
+
+    void renderPage(Room* room, int px, int py);
+};
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include "pathfinding.h"
+#include "util/jobpool.h"
+
+static constexpr float inf = std::numeric_limits<float>::infinity();
+static constexpr float diagonalCost = 1.41421356f;
+
+struct Move {
+    int dx, dy;
+    float cost;
+};
+
+// Orthogonal moves first, so a search without diagonals only looks at the first four
+static const Move moves[8] = {
+    { 1, 0, 1.0f }, { -1, 0, 1.0f }, { 0, 1, 1.0f }, { 0, -1, 1.0f },
+    { 1, 1, diagonalCost }, { -1, 1, diagonalCost }, { 1, -1, diagonalCost }, { -1, -1, diagonalCost }
+};
+
+// Diagonal steps can't cut the corner of a blocked cell
+static bool CanMove(const SolidityGrid& grid, int x, int y, const Move& m) {
+    if (grid.isBlocked(x + m.dx, y + m.dy)) return false;
+    if (m.dx != 0 && m.dy != 0) {
+        return !grid.isBlocked(x + m.dx, y) && !grid.isBlocked(x, y + m.dy);
+    }
+    return true;
+}
+
+static float Heuristic(sf::Vector2i a, sf::Vector2i b, bool diagonal) {
+    float dx = std::abs(a.x - b.x);
+    float dy = std::abs(a.y - b.y);
+    if (!diagonal) return dx + dy;
+    return std::max(dx, dy) + (diagonalCost - 1.0f) * std::min(dx, dy);
+}
+
+static void SearchPath(const SolidityGrid& grid, sf::Vector2i start, sf::Vector2i goal, bool diagonal, PathRequest& out) {
+    int width = grid.width;
+    if (start.x < 0 || start.y < 0 || start.x >= width || start.y >= grid.height || grid.isBlocked(goal.x, goal.y)) {
+        return;
+    }
+
+    size_t count = static_cast<size_t>(width) * grid.height;
+    std::vector<float> cost(count, inf);
+    std::vector<int> parent(count, -1);
+    std::vector<uint8_t> closed(count, 0);
+
+    using Node = std::pair<float, int>;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open;
+
+    int startIdx = start.x + start.y * width;
+    int goalIdx = goal.x + goal.y * width;
+    cost[startIdx] = 0;
+    open.push({ Heuristic(start, goal, diagonal), startIdx });
+
+    int moveCount = (diagonal) ? 8 : 4;
+    while (!open.empty()) {
+        int idx = open.top().second;
+        open.pop();
+        if (closed[idx]) continue;
+        closed[idx] = 1;
+
+        if (idx == goalIdx) {
+            for (int at = goalIdx; at != -1; at = parent[at]) {
+                out.cells.push_back({ at % width, at / width });
+            }
+            std::reverse(out.cells.begin(), out.cells.end());
+            out.found = true;
+            return;
+        }
+
+        int x = idx % width;
+        int y = idx / width;
+        for (int i = 0; i < moveCount; ++i) {
+            const Move& m = moves[i];
+            if (!CanMove(grid, x, y, m)) continue;
+
+            int next = (x + m.dx) + (y + m.dy) * width;
+            float g = cost[idx] + m.cost;
+            if (g < cost[next]) {
+                cost[next] = g;
+                parent[next] = idx;
+                open.push({ g + Heuristic({ x + m.dx, y + m.dy }, goal, diagonal), next });
+            }
+        }
+    }
+}
+
+// Dijkstra outwards from the goal, then every cell points at its cheapest neighbour
+static void BuildFlowField(const SolidityGrid& grid, sf::Vector2i goal, bool diagonal, FlowField& out) {
+    int width = grid.width;
+    size_t count = static_cast<size_t>(width) * grid.height;
+    out.width = width;
+    out.height = grid.height;
+    out.cost.assign(count, inf);
+    out.step.assign(count, { 0, 0 });
+
+    if (grid.isBlocked(goal.x, goal.y)) {
+        return;
+    }
+
+    using Node = std::pair<float, int>;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open;
+    int goalIdx = goal.x + goal.y * width;
+    out.cost[goalIdx] = 0;
+    open.push({ 0.0f, goalIdx });
+
+    int moveCount = (diagonal) ? 8 : 4;
+    while (!open.empty()) {
+        auto [c, idx] = open.top();
+        open.pop();
+        if (c > out.cost[idx]) continue;
+
+        int x = idx % width;
+        int y = idx / width;
+        for (int i = 0; i < moveCount; ++i) {
+            const Move& m = moves[i];
+            if (!CanMove(grid, x, y, m)) continue;
+
+            int next = (x + m.dx) + (y + m.dy) * width;
+            float g = c + m.cost;
+            if (g < out.cost[next]) {
+                out.cost[next] = g;
+                open.push({ g, next });
+            }
+        }
+    }
+
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int idx = x + y * width;
+            if (idx == goalIdx || out.cost[idx] == inf) continue;
+
+            float best = out.cost[idx];
+            for (int i = 0; i < moveCount; ++i) {
+                const Move& m = moves[i];
+                if (!CanMove(grid, x, y, m)) continue;
+                float c = out.cost[(x + m.dx) + (y + m.dy) * width];
+                if (c < best) {
+                    best = c;
+                    out.step[idx] = { static_cast<int8_t>(m.dx), static_cast<int8_t>(m.dy) };
+                }
+            }
+        }
+    }
+}
+
+std::shared_ptr<PathRequest> Pathfinder::findPath(Tilemap* tilemap, sf::Vector2i start, sf::Vector2i goal, bool diagonal) {
+    auto grid = tilemap->soliditySnapshot();
+    Key key = { tilemap, grid->version, start, goal, diagonal };
+
+    auto it = paths.find(key);
+    if (it != paths.end()) {
+        return it->second;
+    }
+
+    if (paths.size() >= maxCachedPaths) {
+        paths.clear();
+    }
+
+    auto request = std::make_shared<PathRequest>();
+    request->tileWidth = grid->tileWidth;
+    request->tileHeight = grid->tileHeight;
+    paths[key] = request;
+
+    JobPool::get().submit([grid, start, goal, diagonal, request]() {
+        SearchPath(*grid, start, goal, diagonal, *request);
+        request->done.store(true, std::memory_order_release);
+    });
+    return request;
+}
+
+std::shared_ptr<FlowField> Pathfinder::flowField(Tilemap* tilemap, sf::Vector2i goal, bool diagonal) {
+    auto grid = tilemap->soliditySnapshot();
+    Key key = { tilemap, grid->version, goal, goal, diagonal };
+
+    auto it = fields.find(key);
+    if (it != fields.end()) {
+        return it->second;
+    }
+
+    if (fields.size() >= maxCachedFields) {
+        fields.clear();
+    }
+
+    auto field = std::make_shared<FlowField>();
+    field->tileWidth = grid->tileWidth;
+    field->tileHeight = grid->tileHeight;
+    fields[key] = field;
+
+    JobPool::get().submit([grid, goal, diagonal, field]() {
+        BuildFlowField(*grid, goal, diagonal, *field);
+        field->done.store(true, std::memory_order_release);
+    });
+    return field;
+}
+
+// lua
+
+template <typename T>
+static std::shared_ptr<T>& ToHandle(lua_State* L, int idx, const char* metatable) {
+    return *static_cast<std::shared_ptr<T>*>(luaL_checkudata(L, idx, metatable));
+}
+
+template <typename T>
+static void PushHandle(lua_State* L, std::shared_ptr<T> handle, const char* metatable) {
+    void* mem = lua_newuserdata(L, sizeof(std::shared_ptr<T>));
+    new(mem) std::shared_ptr<T>(std::move(handle));
+    luaL_setmetatable(L, metatable);
+}
+
+template <typename T>
+static int HandleGc(lua_State* L) {
+    using Handle = std::shared_ptr<T>;
+    static_cast<Handle*>(lua_touserdata(L, 1))->~Handle();
+    return 0;
+}
+
+static sf::Vector2i ToCell(const Tilemap* tilemap, float x, float y) {
+    auto grid = const_cast<Tilemap*>(tilemap)->soliditySnapshot();
+    if (grid->tileWidth == 0 || grid->tileHeight == 0) return { 0, 0 };
+    return {
+        static_cast<int>(std::floor(x / grid->tileWidth)),
+        static_cast<int>(std::floor(y / grid->tileHeight))
+    };
+}
+
+// tilemap, x1, y1, x2, y2, diagonal (default true)
+static int TilemapFindPath(lua_State* L) {
+    Tilemap* tilemap = lua_toclass<Tilemap>(L, 1);
+    sf::Vector2i start = ToCell(tilemap, luaL_checknumber(L, 2), luaL_checknumber(L, 3));
+    sf::Vector2i goal = ToCell(tilemap, luaL_checknumber(L, 4), luaL_checknumber(L, 5));
+    bool diagonal = lua_isnoneornil(L, 6) || lua_toboolean(L, 6);
+
+    PushHandle(L, Pathfinder::get().findPath(tilemap, start, goal, diagonal), "PathRequest");
+    return 1;
+}
+
+// tilemap, goal x, goal y, diagonal (default true)
+static int TilemapFlowField(lua_State* L) {
+    Tilemap* tilemap = lua_toclass<Tilemap>(L, 1);
+    sf::Vector2i goal = ToCell(tilemap, luaL_checknumber(L, 2), luaL_checknumber(L, 3));
+    bool diagonal = lua_isnoneornil(L, 4) || lua_toboolean(L, 4);
+
+    PushHandle(L, Pathfinder::get().flowField(tilemap, goal, diagonal), "FlowField");
+    return 1;
+}
+
+static int PathRequestDone(lua_State* L) {
+    auto& request = ToHandle<PathRequest>(L, 1, "PathRequest");
+    lua_pushboolean(L, request->done.load(std::memory_order_acquire));
+    return 1;
+}
+
+// Returns nil while searching, false without a path, else a list of { x, y } cell centres from start to goal
+static int PathRequestResult(lua_State* L) {
+    auto& request = ToHandle<PathRequest>(L, 1, "PathRequest");
+    if (!request->done.load(std::memory_order_acquire)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    if (!request->found) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    lua_createtable(L, request->cells.size(), 0);
+    int i = 0;
+    for (auto& cell : request->cells) {
+        lua_createtable(L, 0, 2);
+            lua_pushnumber(L, (cell.x + 0.5f) * request->tileWidth);
+            lua_setfield(L, -2, "x");
+            lua_pushnumber(L, (cell.y + 0.5f) * request->tileHeight);
+            lua_setfield(L, -2, "y");
+        lua_rawseti(L, -2, ++i);
+    }
+    return 1;
+}
+
+static int FlowFieldDone(lua_State* L) {
+    auto& field = ToHandle<FlowField>(L, 1, "FlowField");
+    lua_pushboolean(L, field->done.load(std::memory_order_acquire));
+    return 1;
+}
+
+// field, x, y
+// Returns the unit direction towards the next cell on the way to the goal, zero at the goal or when it can't be reached
+static int FlowFieldDirection(lua_State* L) {
+    auto& field = ToHandle<FlowField>(L, 1, "FlowField");
+    float x = luaL_checknumber(L, 2);
+    float y = luaL_checknumber(L, 3);
+
+    float dx = 0, dy = 0;
+    if (field->done.load(std::memory_order_acquire) && field->tileWidth > 0 && field->tileHeight > 0) {
+        int cx = static_cast<int>(std::floor(x / field->tileWidth));
+        int cy = static_cast<int>(std::floor(y / field->tileHeight));
+        if (field->inside(cx, cy)) {
+            auto step = field->step[cx + cy * field->width];
+            if (step.x != 0 || step.y != 0) {
+                // Aim for the centre of the next cell so agents don't slide along walls
+                dx = (cx + step.x + 0.5f) * field->tileWidth - x;
+                dy = (cy + step.y + 0.5f) * field->tileHeight - y;
+                float len = std::sqrt(dx * dx + dy * dy);
+                if (len > 0) {
+                    dx /= len;
+                    dy /= len;
+                }
+            }
+        }
+    }
+
+    lua_pushnumber(L, dx);
+    lua_pushnumber(L, dy);
+    return 2;
+}
+
+// field, x, y
+// Returns the distance to the goal in cells, or nil when it can't be reached (or the field isn't done)
+static int FlowFieldDistance(lua_State* L) {
+    auto& field = ToHandle<FlowField>(L, 1, "FlowField");
+    float x = luaL_checknumber(L, 2);
+    float y = luaL_checknumber(L, 3);
+
+    if (field->done.load(std::memory_order_acquire) && field->tileWidth > 0 && field->tileHeight > 0) {
+        int cx = static_cast<int>(std::floor(x / field->tileWidth));
+        int cy = static_cast<int>(std::floor(y / field->tileHeight));
+        if (field->inside(cx, cy) && field->cost[cx + cy * field->width] != inf) {
+            lua_pushnumber(L, field->cost[cx + cy * field->width]);
+            return 1;
+        }
+    }
+
+    lua_pushnil(L);
+    return 1;
+}
+
+static const luaL_Reg pathRequestFunctions[] = {
+    { "__gc",       HandleGc<PathRequest> },
+    { "done",       PathRequestDone },
+    { "result",     PathRequestResult },
+    { NULL, NULL }
+};
+
+static const luaL_Reg flowFieldFunctions[] = {
+    { "__gc",       HandleGc<FlowField> },
+    { "done",       FlowFieldDone },
+    { "direction",  FlowFieldDirection },
+    { "distance",   FlowFieldDistance },
+    { NULL, NULL }
+};
+
+static const luaL_Reg tilemapPathFunctions[] = {
+    { "find_path",  TilemapFindPath },
+    { "flow_field", TilemapFlowField },
+    { NULL, NULL }
+};
+
+void Pathfinder::initializeLua(lua_State* L) {
+    luaL_newmetatable(L, "PathRequest");
+    luaL_setfuncs(L, pathRequestFunctions, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, "FlowField");
+    luaL_setfuncs(L, flowFieldFunctions, 0);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_getmetatable(L, "Tilemap");
+    luaL_setfuncs(L, tilemapPathFunctions, 0);
+    lua_pop(L, 1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "luainc.h"
+#include "tilemap.h"
+
+// A path search running on the job pool. The main thread polls done before reading anything else.
+struct PathRequest {
+    std::atomic<bool> done { false };
+    bool found = false;
+    std::vector<sf::Vector2i> cells; // start to goal, both included
+    float tileWidth = 0, tileHeight = 0;
+};
+
+// Cost to reach one goal from every cell, plus the best neighbour to step to. One field serves any number of agents.
+struct FlowField {
+    std::atomic<bool> done { false };
+    int width = 0, height = 0;
+    float tileWidth = 0, tileHeight = 0;
+    std::vector<float> cost;            // infinity where the goal can't be reached
+    std::vector<sf::Vector2<int8_t>> step;
+
+    bool inside(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+};
+
+class Pathfinder {
+public:
+    static constexpr size_t maxCachedPaths = 1024;
+    static constexpr size_t maxCachedFields = 64;
+
+    static Pathfinder& get() {
+        static Pathfinder pf;
+        return pf;
+    }
+
+    // Both hand back a shared result immediately, which is already done when it came from the cache
+    std::shared_ptr<PathRequest> findPath(Tilemap* tilemap, sf::Vector2i start, sf::Vector2i goal, bool diagonal);
+    std::shared_ptr<FlowField> flowField(Tilemap* tilemap, sf::Vector2i goal, bool diagonal);
+
+    void initializeLua(lua_State* L);
+
+private:
+    struct Key {
+        const Tilemap* tilemap;
+        unsigned int version;
+        sf::Vector2i start, goal;
+        bool diagonal;
+
+        bool operator==(const Key& o) const {
+            return tilemap == o.tilemap && version == o.version && start == o.start && goal == o.goal && diagonal == o.diagonal;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            size_t h = std::hash<const void*>()(k.tilemap);
+            auto mix = [&h](uint64_t v) { h ^= std::hash<uint64_t>()(v) + 0x9e3779b9 + (h << 6) + (h >> 2); };
+            mix(k.version);
+            mix(static_cast<uint32_t>(k.start.x) | (static_cast<uint64_t>(static_cast<uint32_t>(k.start.y)) << 32));
+            mix(static_cast<uint32_t>(k.goal.x) | (static_cast<uint64_t>(static_cast<uint32_t>(k.goal.y)) << 32));
+            mix(k.diagonal);
+            return h;
+        }
+    };
+
+    // Only touched from the main thread
+    std::unordered_map<Key, std::shared_ptr<PathRequest>, KeyHash> paths;
+    std::unordered_map<Key, std::shared_ptr<FlowField>, KeyHash> fields;
+};
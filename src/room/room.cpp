@@ -1,7 +1,9 @@
 #include <fstream>
 #include "room.h"
+#include "pathfinding.h"
 #include "../game.h"
 #include "../gfx/tileset.h"
+#include "../gfx/renderthread.h"
 #include "../vendor/json.hpp"
 
 Room::Room(LuaState L) : L(L) {
@@ -13,17 +15,418 @@ Room::Room(LuaState& L, RoomReference* data) : Room(L) {
     roomReference = data;
 }
 
+// Reference bookkeeping names, indexed by InstanceKind
+static const std::string kindNames[] = { "instance", "background", "tilemap" };
+
+// Drops the reference to an instance's table and its pointer, so scripts still holding the table can't
+// reach the instance once it's freed or recycled
+static void ReleaseTable(lua_State* L, Object* o) {
+    if (!o->hasTable) return;
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, o->tableReference);
+    if (lua_istable(L, -1)) {
+        lua_pushstring(L, "__cpp_ptr");
+        lua_pushnil(L);
+        lua_rawset(L, -3);
+    }
+    lua_pop(L, 1);
+
+    lua_unreference(L, o->tableReference, kindNames[static_cast<int>(o->kind)]);
+    o->hasTable = false;
+}
+
 Room::~Room() {
-    for (auto& i : instances) {
-        if (!i->hasTable) continue;
-        int type = 0;
-        if (dynamic_cast<Background*>(i.get()))
-            type = 1;
-        if (dynamic_cast<Tilemap*>(i.get()))
-            type = 2;
-        std::string vna = std::string((type==0)?"instance":((type==1)?"background":"tilemap"));
-        lua_unreference(L, i->tableReference, vna);
-        i->hasTable = false;
+    // Rooms are collected at any point of a step, which overlaps the frame in flight
+    GFX::RenderThread::get().waitIdle();
+    grid.clear();
+    inactiveGrid.clear();
+    for (auto* list : { &instances, &deactivated }) {
+        for (auto& i : *list) {
+            ReleaseTable(L, i.get());
+        }
+    }
+}
+
+void Room::registerInstance(Object* o) {
+    o->MyReference.room = this;
+    ids[o->MyReference.id] = o;
+    if (o->active) {
+        grid.insert(o);
+    }
+    else {
+        inactiveGrid.insert(o);
+        ids.erase(o->MyReference.id);
+        activationQueue.push_back(o);
+    }
+}
+
+// The flag and lookups change immediately, moving between lists waits for updateQueue
+void Room::setInstanceActive(Object* o, bool active) {
+    // Destroyed instances are out of the lookups for good, updateQueue releases them
+    if (o->active == active || o->pendingDestroy) {
+        return;
+    }
+    o->active = active;
+
+    if (active) {
+        inactiveGrid.remove(o);
+        grid.insert(o);
+        ids[o->MyReference.id] = o;
+    }
+    else {
+        grid.remove(o);
+        inactiveGrid.insert(o);
+        ids.erase(o->MyReference.id);
+    }
+
+    activationQueue.push_back(o);
+}
+
+void Room::queueDestroy(Object* o) {
+    if (o->pendingDestroy) {
+        return;
+    }
+    o->pendingDestroy = true;
+
+    if (o->kind == InstanceKind::INSTANCE) {
+        ids.erase(o->MyReference.id);
+        grid.remove(o);
+        inactiveGrid.remove(o);
+    }
+    deleteQueue.push_back(o);
+}
+
+void Room::deactivateRegion(const sf::FloatRect& region, bool inside) {
+    std::vector<Object*> found;
+    if (inside) {
+        grid.query(region, [&](Object* o) {
+            if (SpatialGrid::overlaps(o->getBroadphaseRect(), region)) {
+                found.push_back(o);
+            }
+            return true;
+        });
+    }
+    else {
+        for (auto& [id, o] : ids) {
+            if (!SpatialGrid::overlaps(o->getBroadphaseRect(), region)) {
+                found.push_back(o);
+            }
+        }
+    }
+
+    for (auto o : found) {
+        setInstanceActive(o, false);
+    }
+}
+
+void Room::activateRegion(const sf::FloatRect& region, bool inside) {
+    std::vector<Object*> found;
+    if (inside) {
+        inactiveGrid.query(region, [&](Object* o) {
+            if (SpatialGrid::overlaps(o->getBroadphaseRect(), region)) {
+                found.push_back(o);
+            }
+            return true;
+        });
+    }
+    else {
+        auto check = [&](Object* o) {
+            if (!o->active && o->MyReference.room == this && !SpatialGrid::overlaps(o->getBroadphaseRect(), region)) {
+                found.push_back(o);
+            }
+        };
+        for (auto& o : deactivated) check(o.get());
+        for (auto o : activationQueue) if (!o->storedInactive) check(o);
+    }
+
+    for (auto o : found) {
+        setInstanceActive(o, true);
+    }
+}
+
+void Room::updateActiveRegion() {
+    sf::FloatRect region = {
+        { view.x - keepActiveMargin, view.y - keepActiveMargin },
+        { view.width + keepActiveMargin * 2.0f, view.height + keepActiveMargin * 2.0f }
+    };
+    deactivateRegion(region, false);
+    activateRegion(region, true);
+    updateQueue();
+}
+
+Object* Room::instancePlace(const Object* inst, float x, float y, Object* base, uint32_t mask, CollisionResult& result) {
+    result = { false, {} };
+    if (!inst->hasMask()) {
+        return nullptr;
+    }
+
+    OrientedBox box = inst->getBoxAt(x, y);
+    sf::FloatRect bounds = inst->getBroadphaseRect();
+    bounds.position.x += x - inst->x;
+    bounds.position.y += y - inst->y;
+
+    Object* found = nullptr;
+    grid.query(bounds, [&](Object* other) {
+        if (other == inst || !other->hasTable || !other->inLayers(mask) || !other->hasMask()) return true;
+        if (base != nullptr && !other->extends(base)) return true;
+
+        CollisionResult r = boxesIntersect(box, other->getBox());
+        if (r.intersect && inst->preciseMeeting(x, y, other)) {
+            result = r;
+            found = other;
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+Room::MoveResult Room::moveAndCollide(Object* inst, float dx, float dy, Object* solidBase, uint32_t mask, const Tilemap* tilemap) {
+    MoveResult result = { { inst->x, inst->y }, { 0, 0 } };
+    if (!inst->hasMask() || (dx == 0 && dy == 0)) {
+        return result;
+    }
+
+    // Everything the whole move could touch, gathered once from the broadphase
+    sf::FloatRect start = inst->getBroadphaseRect();
+    sf::FloatRect swept = start;
+    swept.position.x += std::min(dx, 0.0f);
+    swept.position.y += std::min(dy, 0.0f);
+    swept.size.x += std::fabs(dx);
+    swept.size.y += std::fabs(dy);
+
+    OrientedBox startBox = inst->getBox();
+    std::vector<Object*> candidates;
+    grid.query(swept, [&](Object* other) {
+        if (other == inst || !other->hasTable || !other->inLayers(mask) || !other->hasMask()) return true;
+        if (solidBase != nullptr && !other->extends(solidBase)) return true;
+        // Already overlapping at the start, let the instance move out instead of sticking to it
+        if (boxesIntersect(startBox, other->getBox()).intersect && inst->preciseMeeting(inst->x, inst->y, other)) return true;
+        candidates.push_back(other);
+        return true;
+    });
+
+    // Tiles already overlapped at the start don't block, so the instance can move out of them. The rest
+    // of the map still does.
+    std::vector<int> startTiles;
+    if (tilemap != nullptr) {
+        tilemap->overlappingTiles(start, startTiles);
+    }
+
+    if (candidates.empty() && tilemap == nullptr) {
+        inst->x += dx;
+        inst->y += dy;
+        inst->boundsChanged();
+        result.position = { inst->x, inst->y };
+        return result;
+    }
+
+    auto blocked = [&](float px, float py) {
+        if (tilemap != nullptr) {
+            // Tiles are tested against the axis aligned bounds, rotation included
+            sf::FloatRect r = start;
+            r.position.x += px - inst->x;
+            r.position.y += py - inst->y;
+            if (tilemap->rectMeeting(r, startTiles.empty() ? nullptr : &startTiles)) return true;
+        }
+        OrientedBox box = inst->getBoxAt(px, py);
+        for (auto other : candidates) {
+            if (boxesIntersect(box, other->getBox()).intersect && inst->preciseMeeting(px, py, other)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Steps at most a pixel at a time so thin walls can't be skipped, then bisects the blocked step
+    float px = inst->x;
+    float py = inst->y;
+    auto sweep = [&](float& pos, float delta, bool horizontal) {
+        float dir = (delta > 0) ? 1.0f : -1.0f;
+        float remaining = std::fabs(delta);
+        while (remaining > 0) {
+            float step = std::min(1.0f, remaining);
+            float next = pos + step * dir;
+            if (horizontal ? blocked(next, py) : blocked(px, next)) {
+                float free = 0.0f, hit = step;
+                for (int i = 0; i < 8; ++i) {
+                    float mid = (free + hit) * 0.5f;
+                    float at = pos + mid * dir;
+                    if (horizontal ? blocked(at, py) : blocked(px, at)) hit = mid;
+                    else free = mid;
+                }
+                pos += free * dir;
+                return -dir;
+            }
+            pos = next;
+            remaining -= step;
+        }
+        return 0.0f;
+    };
+
+    if (dx != 0) result.normal.x = sweep(px, dx, true);
+    if (dy != 0) result.normal.y = sweep(py, dy, false);
+
+    inst->x = px;
+    inst->y = py;
+    inst->boundsChanged();
+    result.position = { px, py };
+    return result;
+}
+
+bool Room::raycast(sf::Vector2f from, sf::Vector2f to, Object* base, uint32_t mask, const Tilemap* tilemap, const Object* ignore, RaycastHit& hit) {
+    float best = std::numeric_limits<float>::infinity();
+    sf::Vector2f bestNormal {};
+    Object* bestInstance = nullptr;
+
+    float t;
+    sf::Vector2f normal;
+    if (tilemap != nullptr && tilemap->raycast(from, to, t, normal)) {
+        best = t;
+        bestNormal = normal;
+    }
+
+    // Instances can span several cells and get tested more than once, which is harmless.
+    // The walk ends once a cell starts past the closest hit so far.
+    TraverseGrid(from, to, { SpatialGrid::cellSize, SpatialGrid::cellSize }, [&](int cx, int cy, float tEnter, float tExit, sf::Vector2f) {
+        if (tEnter > best) return false;
+
+        auto cell = grid.cell(cx, cy);
+        if (cell == nullptr) return true;
+
+        for (Object* other : *cell) {
+            if (other == ignore || !other->hasTable || !other->inLayers(mask) || !other->hasMask()) continue;
+            if (base != nullptr && !other->extends(base)) continue;
+            if (other->raycast(from, to, t, normal) && t < best) {
+                best = t;
+                bestNormal = normal;
+                bestInstance = other;
+            }
+        }
+        return true;
+    });
+
+    if (best > 1.0f) {
+        return false;
+    }
+
+    hit.position = from + (to - from) * best;
+    hit.normal = bestNormal;
+    hit.instance = bestInstance;
+    return true;
+}
+
+void Room::dispatchCollisionEvents(int roomIdx) {
+    auto& pairs = ObjectManager::get().collisionPairs;
+    if (pairs.empty()) {
+        return;
+    }
+
+    struct Contact {
+        Object* a;
+        Object* b;
+        size_t pair;
+    };
+    std::vector<Contact> contacts;
+
+    // Instances share their class' ancestry, so extends() only has to run once per class and pair side
+    auto classOf = [](Object* o) { return (o->self != nullptr) ? o->self : o; };
+    std::unordered_map<Object*, std::vector<Object*>> byClass;
+    for (auto& inst : instances) {
+        Object* a = inst.get();
+        if (a->kind != InstanceKind::INSTANCE || !a->active || !a->hasTable || !a->hasMask()) continue;
+        byClass[classOf(a)].push_back(a);
+    }
+
+    // Find every contact first, the events may move or destroy instances
+    std::unordered_map<Object*, bool> extendsB;
+    for (size_t p = 0; p < pairs.size(); ++p) {
+        auto& pair = pairs[p];
+        bool samePair = pair.a == pair.b;
+        extendsB.clear();
+        auto isB = [&](Object* b) {
+            auto it = extendsB.find(classOf(b));
+            if (it == extendsB.end()) {
+                it = extendsB.emplace(classOf(b), b->extends(pair.b)).first;
+            }
+            return it->second;
+        };
+
+        for (auto& [cls, members] : byClass) {
+            if (!cls->extends(pair.a)) continue;
+
+            for (Object* a : members) {
+                OrientedBox box = a->getBox();
+                grid.query(a->getBroadphaseRect(), [&](Object* b) {
+                    if (b == a || !b->hasTable || !b->inLayers(a->collisionMask) || !b->hasMask() || !isB(b)) return true;
+                    // Both sides extend the same class, only report the pair once
+                    if (samePair && b->MyReference.id < a->MyReference.id) return true;
+                    if (boxesIntersect(box, b->getBox()).intersect && a->preciseMeeting(a->x, a->y, b)) {
+                        contacts.push_back({ a, b, p });
+                    }
+                    return true;
+                });
+            }
+        }
+    }
+
+    for (auto& c : contacts) {
+        auto& pair = pairs[c.pair];
+        if (!pair.eventA.empty() && c.a->active && !c.a->pendingDestroy && c.b->active && !c.b->pendingDestroy) {
+            c.a->runScriptCollision(pair.eventA, roomIdx, c.b);
+        }
+        if (!pair.eventB.empty() && c.a->active && !c.a->pendingDestroy && c.b->active && !c.b->pendingDestroy) {
+            c.b->runScriptCollision(pair.eventB, roomIdx, c.a);
+        }
+    }
+}
+
+void Room::updateQueue() {
+    // Add queued objects
+    int size = instances.size();
+    for (auto& o : addQueue) {
+        o->vectorPos = size;
+        instances.push_back(std::move(o));
+        size++;
+    }
+    addQueue.clear();
+
+    auto removeAt = [](std::vector<std::unique_ptr<Object>>& vec, size_t pos) {
+        std::unique_ptr<Object> removed = std::move(vec[pos]);
+        if (pos != vec.size() - 1) {
+            vec[pos] = std::move(vec.back());
+            vec[pos]->vectorPos = pos;
+        }
+        vec.pop_back();
+        return removed;
+    };
+
+    // Move instances between the active and deactivated lists
+    if (!activationQueue.empty()) {
+        for (auto o : activationQueue) {
+            bool wantInactive = !o->active;
+            if (wantInactive == o->storedInactive) continue;
+
+            auto& from = (wantInactive) ? instances : deactivated;
+            auto& to = (wantInactive) ? deactivated : instances;
+            std::unique_ptr<Object> moved = removeAt(from, o->vectorPos);
+            moved->vectorPos = to.size();
+            moved->storedInactive = wantInactive;
+            to.push_back(std::move(moved));
+        }
+        activationQueue.clear();
+    }
+
+    // Delete objects queued for deletion, each swap-removed in constant time
+    if (!deleteQueue.empty()) {
+        auto& objMgr = ObjectManager::get();
+        for (auto o : deleteQueue) {
+            ReleaseTable(L, o);
+
+            auto& from = (o->storedInactive) ? deactivated : instances;
+            objMgr.releaseInstance(removeAt(from, o->vectorPos));
+        }
+        deleteQueue.clear();
     }
 }
 
@@ -32,6 +435,7 @@ void Room::initializeLua(LuaState& lua, const std::filesystem::path &assets) {
     RoomViewInitializeLua(lua, assets);
     BackgroundInitializeLua(lua, assets);
     TilemapInitializeLua(lua, assets);
+    Pathfinder::get().initializeLua(lua);
 }
 
 void Room::load(int roomIdx) {
@@ -259,7 +663,7 @@ void Room::load(int roomIdx) {
                         // Fetch original object
                         Object* original = lua_toclass<Object>(L, objIdx);
 
-                        std::unique_ptr<Object> o = std::make_unique<Object>(*original);
+                        std::unique_ptr<Object> o = objMgr.acquireInstance(*original);
                         ptr = o.get();
                             PushNewInstance(L, objIdx, objectId, ptr, original);
                         int tableIdx = lua_reference(L, "instance"); // idx
@@ -276,7 +680,7 @@ void Room::load(int roomIdx) {
                     ptr->MyReference.object = ptr;
 
                     addQueue.push_back(std::move(o));
-                    ids[objectId] = ptr;
+                    registerInstance(ptr);
                 }
                 else {
                     scrappedPtr = std::make_unique<Object>(L);
@@ -305,6 +709,8 @@ void Room::load(int roomIdx) {
                     uint8_t c;
                     for (int i = 0; i < 4; ++i)
                     in.read(reinterpret_cast<char*>(&c), sizeof(uint8_t));
+
+                    ptr->boundsChanged();
                 }
                 int propertyCount;
                 in.read(reinterpret_cast<char*>(&propertyCount), sizeof(propertyCount));
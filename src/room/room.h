@@ -3,7 +3,9 @@
 #include <iostream>
 #include "../object/object.h"
 #include "tilemap.h"
+#include "spatialgrid.h"
 #include "roomreference.h"
+#include "layercache.h"
 
 void RoomInitializeLua(lua_State* L, const std::filesystem::path& assets);
 void RoomViewInitializeLua(lua_State* L, const std::filesystem::path& assets);
@@ -19,7 +21,8 @@ public:
     bool offsetX, offsetY;
     sf::Color color = { 255, 255, 255, 255 };
 
-    Background(LuaState L) : Object(L) {}
+    Background(LuaState L) : Object(L) { kind = InstanceKind::BACKGROUND; }
+    bool intersectsView(const sf::FloatRect& viewRect, float alpha) const override { return true; }
     void draw(Room* room, float alpha) override;
 };
 
@@ -62,60 +65,74 @@ public:
     std::vector<Tilemap*> tilemaps {};
 
     std::vector<std::unique_ptr<Object>> addQueue {};
-    std::vector<size_t> deleteQueue {};
-    
+    std::vector<Object*> deleteQueue {};
+    std::vector<Object*> activationQueue {};
+
     std::unordered_map<ObjectId, Object*> ids {};
 
+    // Deactivated instances are kept out of instances, ids and grid entirely
+    std::vector<std::unique_ptr<Object>> deactivated {};
+
+    // Broadphase over active instances, and a separate one to find deactivated ones by region
+    SpatialGrid grid {};
+    SpatialGrid inactiveGrid {};
+
+    // Keeps instances around the view active and everything else deactivated, every step
+    bool keepActiveAroundView = false;
+    float keepActiveMargin = 0.0f;
+
     int width = 0;
     int height = 0;
     View view {};
 
+    // View culling for RoomDraw
+    bool cullDrawing = false;
+    float cullMargin = 32.0f;
+    int culledCount = 0;
+
+    // Static tilemap layers drawn from render textures, keyed by the first layer of each run
+    std::unordered_map<const Tilemap*, std::unique_ptr<LayerCache>> layerCaches {};
+
     Room(LuaState& L, RoomReference* data);
     Room(LuaState L);
     ~Room();
 
     void load(int roomIdx);
 
-    void updateQueue() {
-        // Add queued objects
-        int size = instances.size();
-        for (auto& o : addQueue) {
-            o->vectorPos = size;
-            instances.push_back(std::move(o));
-            size++;
-        }
+    // Adds an instance to the id table and broadphase, once its position is set
+    void registerInstance(Object* o);
+    void setInstanceActive(Object* o, bool active);
+    // Queues anything in the instance list for removal at the next updateQueue, once
+    void queueDestroy(Object* o);
+    void deactivateRegion(const sf::FloatRect& region, bool inside);
+    void activateRegion(const sf::FloatRect& region, bool inside);
+    void updateActiveRegion();
+
+    // First active instance extending base (any instance when null) on one of the mask's layers that the box
+    // of inst overlaps when placed at x, y. The translation in result pushes inst out of the returned instance.
+    Object* instancePlace(const Object* inst, float x, float y, Object* base, uint32_t mask, CollisionResult& result);
+
+    struct MoveResult {
+        sf::Vector2f position;
+        sf::Vector2f normal; // of whatever stopped each axis, zero where the move finished
+    };
 
-        // Delete objects queued for deletion
-        if (!deleteQueue.empty()) {
-            std::sort(deleteQueue.begin(), deleteQueue.end(), std::greater<size_t>());
-            for (auto& pos : deleteQueue) {
-                int type = 0;
-                if (dynamic_cast<Background*>(instances[pos].get()))
-                    type = 1;
-                if (dynamic_cast<Tilemap*>(instances[pos].get()))
-                    type = 2;
-                std::string vna = std::string((type == 0) ? "instance" : ((type == 1) ? "background" : "tilemap"));
-                size_t size = instances.size();
-                if (pos >= size - 1) {
-                    lua_unreference(L, instances[pos]->tableReference, vna);
-                    instances[pos]->hasTable = false;
-
-                    instances.pop_back();
-                }
-                else {
-                    lua_unreference(L, instances[pos]->tableReference, vna);
-                    instances[pos]->hasTable = false;
-
-                    std::swap(instances[pos], instances[instances.size() - 1]);
-
-                    instances.pop_back();
-                    instances[pos]->vectorPos = pos;
-                }
-            }
-            deleteQueue.clear();
-        }
+    // Moves inst by dx then dy, stopping each axis at the first instance extending solidBase
+    // (any instance when null) on one of the mask's layers, or solid tile of the tilemap (when given).
+    MoveResult moveAndCollide(Object* inst, float dx, float dy, Object* solidBase, uint32_t mask, const Tilemap* tilemap);
+
+    struct RaycastHit {
+        sf::Vector2f position;
+        sf::Vector2f normal;
+        Object* instance; // null when the tilemap was hit
+    };
+
+    // First instance extending base (any instance when null) or solid tile along the segment.
+    // Tiles are walked cell by cell and instances through the broadphase cells the segment crosses.
+    bool raycast(sf::Vector2f from, sf::Vector2f to, Object* base, uint32_t mask, const Tilemap* tilemap, const Object* ignore, RaycastHit& hit);
+
+    // Runs the collision events of registered class pairs for every overlapping pair of instances, once per tick
+    void dispatchCollisionEvents(int roomIdx);
 
-        addQueue.clear();
-        deleteQueue.clear();
-    }
+    void updateQueue();
 };
\ No newline at end of file
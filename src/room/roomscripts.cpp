@@ -1,5 +1,7 @@
 #include "room.h"
 #include "../game.h"
+#include "gfx/spritebatch.h"
+#include "gfx/commandbuffer.h"
 
 int PushNewInstance(lua_State* L, int originalTableIndex, ObjectId objectId, Object* instance, Object* pseudoclass) {
     lua_newtable(L); // table
@@ -99,6 +101,21 @@ static int RoomGet(lua_State* L) {
         return 1;
     }
 
+    if (strcmp("draw_culling", key) == 0) {
+        lua_pushboolean(L, room->cullDrawing);
+        return 1;
+    }
+
+    if (strcmp("cull_margin", key) == 0) {
+        lua_pushnumber(L, room->cullMargin);
+        return 1;
+    }
+
+    if (strcmp("culled_count", key) == 0) {
+        lua_pushinteger(L, room->culledCount);
+        return 1;
+    }
+
     lua_pushvalue(L, 2); // push key
     lua_rawget(L, 1); // consumes key
 
@@ -129,6 +146,10 @@ static int RoomStep(lua_State* L) {
     room->view.width = game.canvasWidth;
     room->view.height = game.canvasHeight;
 
+    if (room->keepActiveAroundView) {
+        room->updateActiveRegion();
+    }
+
     for (auto& i : room->instances) {
         if (i->active) {
             i->xPrev = i->x;
@@ -157,6 +178,10 @@ static int RoomStep(lua_State* L) {
     }
     room->updateQueue();
 
+    // Collision
+    room->dispatchCollisionEvents(1);
+    room->updateQueue();
+
     // End Step
     for (auto& instance : room->instances) {
         if (instance->active) {
@@ -168,6 +193,34 @@ static int RoomStep(lua_State* L) {
     return 0;
 }
 
+static bool IsCachedLayer(const Object* o) {
+    return o->kind == InstanceKind::TILEMAP && static_cast<const Tilemap*>(o)->cached;
+}
+
+// Draws the run of cached tilemaps starting at first through one layer cache, returns where the run ends
+static size_t DrawCachedLayers(Room* room, size_t first, std::vector<const Tilemap*>& used) {
+    std::vector<Tilemap*> run;
+    size_t end = first;
+    while (end < room->drawables.size() && IsCachedLayer(room->drawables[end])) {
+        run.push_back(static_cast<Tilemap*>(room->drawables[end]));
+        ++end;
+    }
+
+    used.push_back(run.front());
+    auto& cache = room->layerCaches[run.front()];
+    if (!cache) {
+        cache = std::make_unique<LayerCache>();
+    }
+    if (!cache->matches(run)) {
+        cache->reset(run, room->width, room->height);
+    }
+
+    sf::RenderTarget* target = Game::get().getRenderTarget();
+    const sf::View& view = target->getView();
+    cache->draw(room, *target, { view.getCenter() - view.getSize() / 2.0f, view.getSize() });
+    return end;
+}
+
 static int RoomDraw(lua_State* L) {
     Room* room = lua_toclass<Room>(L, 1);
 
@@ -190,15 +243,65 @@ static int RoomDraw(lua_State* L) {
         d->runScriptDraw("begin_draw", 1, alpha);
     }
 
-    for (auto& d : room->drawables) {
+    // Grow the current view by the margin; anything outside of it gets skipped
+    sf::FloatRect cullRect;
+    if (room->cullDrawing) {
+        const sf::View& view = Game::get().getRenderTarget()->getView();
+        sf::Vector2f size = view.getSize();
+        cullRect.position = view.getCenter() - (size / 2.0f) - sf::Vector2f(room->cullMargin, room->cullMargin);
+        cullRect.size = size + sf::Vector2f(room->cullMargin * 2.0f, room->cullMargin * 2.0f);
+    }
+    room->culledCount = 0;
+
+    auto& commands = GFX::CommandBuffer::get();
+    std::vector<const Tilemap*> usedCaches;
+    for (size_t i = 0; i < room->drawables.size(); ++i) {
+        Object* d = room->drawables[i];
+        commands.setDepth(d->depth);
+        if (IsCachedLayer(d)) {
+            i = DrawCachedLayers(room, i, usedCaches) - 1;
+            continue;
+        }
+        bool inView = !room->cullDrawing || d->intersectsView(cullRect, alpha);
         if (d->hasTable) {
+            // Only opted-in classes have their draw event culled, since it can draw anywhere
+            if (!inView && d->cullScriptDraw) {
+                room->culledCount++;
+                continue;
+            }
             if (!d->runScriptDraw("draw", 1, alpha)) {
-                d->draw(room, alpha);
+                if (inView) {
+                    d->draw(room, alpha);
+                }
+                else {
+                    room->culledCount++;
+                }
             }
         }
-        else {
+        else if (inView) {
             d->draw(room, alpha);
         }
+        else {
+            room->culledCount++;
+        }
+    }
+    commands.clearDepth();
+
+    // Runs change with visibility, depth and the cached flag, a cache no run started from is dead weight
+    bool evicting = std::any_of(room->layerCaches.begin(), room->layerCaches.end(), [&](const auto& entry) {
+        return std::find(usedCaches.begin(), usedCaches.end(), entry.first) == usedCaches.end();
+    });
+    if (evicting) {
+        // Draws recorded earlier in the frame may still sample the pages
+        commands.submit();
+        for (auto it = room->layerCaches.begin(); it != room->layerCaches.end();) {
+            if (std::find(usedCaches.begin(), usedCaches.end(), it->first) == usedCaches.end()) {
+                it = room->layerCaches.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
     }
     
     for (auto& d : room->drawables) {
@@ -207,7 +310,7 @@ static int RoomDraw(lua_State* L) {
     }
 
     auto target = Game::get().getRenderTarget();
-    target->setView(target->getDefaultView());
+    GFX::CommandBuffer::get().setView(*target, target->getDefaultView());
 
     for (auto& d : room->drawables) {
         if (!d->hasTable) continue;
@@ -226,6 +329,16 @@ static int RoomSet(lua_State* L) {
         return 0;
     }
 
+    if (strcmp(key, "draw_culling") == 0) {
+        room->cullDrawing = lua_toboolean(L, 3);
+        return 0;
+    }
+
+    if (strcmp(key, "cull_margin") == 0) {
+        room->cullMargin = luaL_checknumber(L, 3);
+        return 0;
+    }
+
     lua_pushvalue(L, 2);    // k
     lua_pushvalue(L, 3);    // v
     lua_rawset(L, 1);
@@ -278,6 +391,12 @@ static int RoomCreate(lua_State* L) {
     return 1; // return room
 }
 
+// Optional collision layer mask argument
+static uint32_t ToLayerMask(lua_State* L, int idx, uint32_t fallback = Object::allCollisionLayers) {
+    return lua_isnoneornil(L, idx) ? fallback : static_cast<uint32_t>(luaL_checkinteger(L, idx));
+}
+
+// room, caller, x1, y1, x2, y2, class (nil for any), ignore (optional), layer mask (optional)
 static int RoomInstancesRect(lua_State* L) {
     int argcount = lua_gettop(L);
 
@@ -296,29 +415,34 @@ static int RoomInstancesRect(lua_State* L) {
     bool inst = lua_isnil(L, -1);
     lua_pop(L, 1); // pop nil instance
 
-    const Object* ignore = (argcount < 8) ? nullptr : lua_toclass<Object>(L, 8);
-    Object* base = (inst) ? lua_toclass<Object>(L, 7)->self : lua_toclass<Object>(L, 7);
+    const Object* ignore = (argcount < 8 || !lua_istable(L, 8)) ? nullptr : lua_torawclass<Object>(L, 8);
+    Object* base = nullptr;
+    if (lua_istable(L, 7)) {
+        base = (inst) ? lua_toclass<Object>(L, 7)->self : lua_toclass<Object>(L, 7);
+    }
+    uint32_t mask = ToLayerMask(L, 9);
     lua_newtable(L);
     int count = 0;
-    for (auto& i : room->ids) {
-        auto& instance = i.second;
-        if (i.second->hasTable && i.second->active && i.second->extends(base)) {
-            if (ignore == nullptr || i.second != ignore) {
+    room->grid.query(rect, [&](Object* instance) {
+        if (instance->hasTable && instance->active && instance->inLayers(mask) && (base == nullptr || instance->extends(base))) {
+            if (ignore == nullptr || instance != ignore) {
                 sf::FloatRect otherRect = { { instance->getBboxLeft(), instance->bboxTop() }, { 0, 0 } };
                 otherRect.size.x = instance->bboxRight() - otherRect.position.x;
                 otherRect.size.y = instance->bboxBottom() - otherRect.position.y;
                 auto intersection = rect.findIntersection(otherRect);
-                if (intersection.has_value()) {
+                if (intersection.has_value() && instance->preciseRectMeeting(rect)) {
                     count++;
                     lua_rawgeti(L, LUA_REGISTRYINDEX, instance->tableReference);
                     lua_rawseti(L, -2, count);
                 }
             }
         }
-    }
+        return true;
+    });
     return 1;
 }
 
+// room, caller, x1, y1, x2, y2, class or instance (nil for any), ignore (optional), layer mask (optional)
 static int RoomInstanceRect(lua_State* L) {
     int argcount = lua_gettop(L);
 
@@ -332,8 +456,14 @@ static int RoomInstanceRect(lua_State* L) {
     float height = bottom - top;
 
     sf::FloatRect rect = { { left, top }, { width, height } };
+    uint32_t mask = ToLayerMask(L, 9);
 
-    lua_getfield(L, 7, "__id");
+    if (lua_istable(L, 7)) {
+        lua_getfield(L, 7, "__id");
+    }
+    else {
+        lua_pushnil(L);
+    }
     bool isInstance = !lua_isnil(L, -1);
     if (isInstance) {
         int instanceId = lua_tointeger(L, -1);
@@ -346,7 +476,7 @@ static int RoomInstanceRect(lua_State* L) {
         }
         
         Object* foundInstance = it->second;
-        if (!foundInstance->active || !foundInstance->hasTable) {
+        if (!foundInstance->active || !foundInstance->hasTable || !foundInstance->inLayers(mask)) {
             lua_pushnil(L); // nil
             return 1;
         }
@@ -357,7 +487,7 @@ static int RoomInstanceRect(lua_State* L) {
         auto intersection = rect.findIntersection(otherRect);
         
         // Intersection vs none
-        if (intersection.has_value()) {
+        if (intersection.has_value() && foundInstance->preciseRectMeeting(rect)) {
             lua_rawgeti(L, LUA_REGISTRYINDEX, foundInstance->tableReference);
             return 1;
         }
@@ -369,29 +499,224 @@ static int RoomInstanceRect(lua_State* L) {
     else {
         lua_pop(L, 1); // pop nil instance
 
-        Object* base = lua_toclass<Object>(L, 7);
-        const Object* ignore = (argcount >= 8) ? lua_toclass<Object>(L, 8) : nullptr;
+        Object* base = (lua_istable(L, 7)) ? lua_toclass<Object>(L, 7) : nullptr;
+        const Object* ignore = (argcount >= 8 && lua_istable(L, 8)) ? lua_torawclass<Object>(L, 8) : nullptr;
 
-        for (auto& i : room->ids) {
-            auto& instance = i.second;
-            if (i.second->hasTable &&
-                i.second->active &&
-                i.second->extends(base)) {
-                if (ignore == nullptr || i.second != ignore) {
+        Object* found = nullptr;
+        room->grid.query(rect, [&](Object* instance) {
+            if (instance->hasTable &&
+                instance->active &&
+                instance->inLayers(mask) &&
+                (base == nullptr || instance->extends(base))) {
+                if (ignore == nullptr || instance != ignore) {
                     sf::FloatRect otherRect = { { instance->getBboxLeft(), instance->bboxTop() }, { 0, 0 } };
                     otherRect.size.x = instance->bboxRight() - otherRect.position.x;
                     otherRect.size.y = instance->bboxBottom() - otherRect.position.y;
                     auto intersection = rect.findIntersection(otherRect);
-                    if (intersection.has_value()) {
-                        lua_rawgeti(L, LUA_REGISTRYINDEX, instance->tableReference);
-                        return 1;
+                    if (intersection.has_value() && instance->preciseRectMeeting(rect)) {
+                        found = instance;
+                        return false;
                     }
                 }
             }
+            return true;
+        });
+
+        if (found) {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, found->tableReference);
+            return 1;
+        }
+        lua_pushnil(L);
+        return 1;
+    }
+}
+
+// room, instance, x, y, class (optional), layer mask (defaults to the instance's collision_mask)
+// Returns the instance met, and the translation that pushes the instance out of it
+static int RoomInstancePlace(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    Object* inst = lua_torawclass<Object>(L, 2);
+    if (inst == nullptr) {
+        return luaL_error(L, "instance has been destroyed");
+    }
+    float x = luaL_checknumber(L, 3);
+    float y = luaL_checknumber(L, 4);
+
+    Object* base = nullptr;
+    if (!lua_isnoneornil(L, 5)) {
+        base = lua_toclass<Object>(L, 5);
+        if (base != nullptr && lua_getfieldexists(L, 5, "__id")) {
+            base = base->self;
+        }
+    }
+
+    if (inst == nullptr) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    CollisionResult result;
+    Object* found = room->instancePlace(inst, x, y, base, ToLayerMask(L, 6, inst->collisionMask), result);
+    if (found == nullptr) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, found->tableReference);
+    lua_pushnumber(L, result.mtv.x);
+    lua_pushnumber(L, result.mtv.y);
+    return 3;
+}
+
+// room, instance, dx, dy, solid class (optional), tilemap (optional), layer mask (defaults to the instance's collision_mask)
+// Returns the resolved position and the normal of whatever stopped each axis
+static int RoomMoveAndCollide(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    Object* inst = lua_torawclass<Object>(L, 2);
+    if (inst == nullptr) {
+        return luaL_error(L, "instance has been destroyed");
+    }
+    float dx = luaL_checknumber(L, 3);
+    float dy = luaL_checknumber(L, 4);
+
+    Object* base = nullptr;
+    if (!lua_isnoneornil(L, 5)) {
+        base = lua_toclass<Object>(L, 5);
+        if (base != nullptr && lua_getfieldexists(L, 5, "__id")) {
+            base = base->self;
         }
+    }
+
+    const Tilemap* tilemap = (lua_isnoneornil(L, 6)) ? nullptr : lua_toclass<Tilemap>(L, 6);
+
+    if (inst == nullptr) {
         lua_pushnil(L);
         return 1;
     }
+
+    Room::MoveResult result = room->moveAndCollide(inst, dx, dy, base, ToLayerMask(L, 7, inst->collisionMask), tilemap);
+    lua_pushnumber(L, result.position.x);
+    lua_pushnumber(L, result.position.y);
+    lua_pushnumber(L, result.normal.x);
+    lua_pushnumber(L, result.normal.y);
+    return 4;
+}
+
+struct RaycastOptions {
+    Object* base = nullptr;
+    uint32_t mask = Object::allCollisionLayers;
+    const Tilemap* tilemap = nullptr;
+    const Object* ignore = nullptr;
+};
+
+// { class = ..., mask = ..., tilemap = ..., ignore = ... }, every field optional
+static RaycastOptions ToRaycastOptions(lua_State* L, int idx) {
+    RaycastOptions opts;
+    if (!lua_istable(L, idx)) {
+        return opts;
+    }
+
+    lua_getfield(L, idx, "class");
+    if (lua_istable(L, -1)) {
+        opts.base = lua_toclass<Object>(L, -1);
+        if (opts.base != nullptr && lua_getfieldexists(L, -1, "__id")) {
+            opts.base = opts.base->self;
+        }
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "mask");
+    opts.mask = ToLayerMask(L, -1, opts.mask);
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "tilemap");
+    if (lua_istable(L, -1)) {
+        opts.tilemap = lua_toclass<Tilemap>(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, idx, "ignore");
+    if (lua_istable(L, -1)) {
+        opts.ignore = lua_torawclass<Object>(L, -1);
+    }
+    lua_pop(L, 1);
+
+    return opts;
+}
+
+// Pushes whatever was hit, the instance table or the tilemap table
+static void PushRaycastTarget(lua_State* L, const Room::RaycastHit& hit, const RaycastOptions& opts) {
+    const Object* target = (hit.instance) ? hit.instance : opts.tilemap;
+    if (target != nullptr && target->hasTable) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, target->tableReference);
+    }
+    else {
+        lua_pushnil(L);
+    }
+}
+
+// room, x1, y1, x2, y2, options (optional)
+// Returns x, y, what was hit, normal x, normal y, or nil when nothing was hit
+static int RoomRaycast(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    sf::Vector2f from = { static_cast<float>(luaL_checknumber(L, 2)), static_cast<float>(luaL_checknumber(L, 3)) };
+    sf::Vector2f to = { static_cast<float>(luaL_checknumber(L, 4)), static_cast<float>(luaL_checknumber(L, 5)) };
+    RaycastOptions opts = ToRaycastOptions(L, 6);
+
+    Room::RaycastHit hit;
+    if (!room->raycast(from, to, opts.base, opts.mask, opts.tilemap, opts.ignore, hit)) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    lua_pushnumber(L, hit.position.x);
+    lua_pushnumber(L, hit.position.y);
+    PushRaycastTarget(L, hit, opts);
+    lua_pushnumber(L, hit.normal.x);
+    lua_pushnumber(L, hit.normal.y);
+    return 5;
+}
+
+// room, { { x1, y1, x2, y2 }, ... }, options (optional)
+// Returns a list with a { x, y, hit, nx, ny } table per ray, or false where a ray hit nothing
+static int RoomRaycastBatch(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    RaycastOptions opts = ToRaycastOptions(L, 3);
+
+    int count = lua_rawlen(L, 2);
+    lua_createtable(L, count, 0);
+    for (int i = 1; i <= count; ++i) {
+        lua_rawgeti(L, 2, i);
+        float coords[4];
+        for (int j = 0; j < 4; ++j) {
+            lua_rawgeti(L, -1, j + 1);
+            coords[j] = lua_tonumber(L, -1);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+
+        Room::RaycastHit hit;
+        if (!room->raycast({ coords[0], coords[1] }, { coords[2], coords[3] }, opts.base, opts.mask, opts.tilemap, opts.ignore, hit)) {
+            lua_pushboolean(L, false);
+            lua_rawseti(L, -2, i);
+            continue;
+        }
+
+        lua_createtable(L, 0, 5);
+            lua_pushnumber(L, hit.position.x);
+            lua_setfield(L, -2, "x");
+            lua_pushnumber(L, hit.position.y);
+            lua_setfield(L, -2, "y");
+            PushRaycastTarget(L, hit, opts);
+            lua_setfield(L, -2, "hit");
+            lua_pushnumber(L, hit.normal.x);
+            lua_setfield(L, -2, "nx");
+            lua_pushnumber(L, hit.normal.y);
+            lua_setfield(L, -2, "ny");
+        lua_rawseti(L, -2, i);
+    }
+    return 1;
 }
 
 static int RoomInstanceExists(lua_State* L) {
@@ -401,7 +726,7 @@ static int RoomInstanceExists(lua_State* L) {
     }
 
     Room* room = lua_toclass<Room>(L, 1);
-    Object* object = lua_toclass<Object>(L, 2);
+    Object* object = lua_torawclass<Object>(L, 2);
 
     if (object == nullptr) {
         lua_pushboolean(L, false);
@@ -444,8 +769,7 @@ static int RoomInstanceDestroy(lua_State* L) {
         if (idPos != room->ids.end()) {
             auto object = idPos->second;
             object->runScriptTimestep("destroy", 1);
-            room->deleteQueue.push_back(object->vectorPos);
-            room->ids.erase(object->MyReference.id);
+            room->queueDestroy(object);
         }
 
         return 0;
@@ -454,22 +778,26 @@ static int RoomInstanceDestroy(lua_State* L) {
     lua_pop(L, 1);
 
     if (Object* original = lua_testclass<Object>(L, 2, "Object")) {
+        // Collect first, destroy events can change ids
+        std::vector<ObjectId> matches;
         for (auto& [k, i] : room->ids) {
             if (i->extends(original)) {
-                ObjectId id = i->MyReference.id;
-                auto idPos = room->ids.find(id);
-                if (idPos != room->ids.end()) {
-                    i->runScriptTimestep("destroy", 1);
-                    room->deleteQueue.push_back(i->vectorPos);
-                    room->ids.erase(id);
-                }
+                matches.push_back(k);
+            }
+        }
+        for (ObjectId id : matches) {
+            auto idPos = room->ids.find(id);
+            if (idPos != room->ids.end()) {
+                Object* i = idPos->second;
+                i->runScriptTimestep("destroy", 1);
+                room->queueDestroy(i);
             }
         }
         return 0;
     }
     
     if (Background* background = lua_testclass<Background>(L, 2, "Background")) {
-        room->deleteQueue.push_back(background->vectorPos);
+        room->queueDestroy(background);
         auto it = std::find(room->backgrounds.begin(), room->backgrounds.end(), background);
         if (it != room->backgrounds.end()) {
             room->backgrounds.erase(it);
@@ -478,7 +806,7 @@ static int RoomInstanceDestroy(lua_State* L) {
     }
 
     if (Tilemap* tilemap = lua_testclass<Tilemap>(L, 2, "Tilemap")) {
-        room->deleteQueue.push_back(tilemap->vectorPos);
+        room->queueDestroy(tilemap);
         auto it = std::find(room->tilemaps.begin(), room->tilemaps.end(), tilemap);
         if (it != room->tilemaps.end()) {
             room->tilemaps.erase(it);
@@ -497,7 +825,7 @@ static int RoomInstanceCreate(lua_State* L) {
     Object* original = lua_toclass<Object>(L, 5);
 
     ObjectId objectId = room->currentId++;
-    std::unique_ptr<Object> o = std::make_unique<Object>(*original);
+    std::unique_ptr<Object> o = ObjectManager::get().acquireInstance(*original);
         PushNewInstance(L, 5, objectId, o.get(), original);
     int tableIdx = lua_reference(L, "instance");
     
@@ -507,11 +835,11 @@ static int RoomInstanceCreate(lua_State* L) {
     Object* ptr = o.get();
     ptr->MyReference = { objectId, room->myId, ptr };
     room->addQueue.push_back(std::move(o));
-    room->ids[objectId] = ptr;
 
     ptr->x = x;
     ptr->y = y;
     ptr->depth = depth;
+    room->registerInstance(ptr);
     ptr->runScriptTimestep("create", 1);
     ptr->xPrevRender = ptr->xPrev = ptr->x;
     ptr->yPrevRender = ptr->yPrev = ptr->y;
@@ -535,7 +863,7 @@ static int RoomSetRenderPosition(lua_State* L) {
     sf::View view(sf::FloatRect { { 0.0f, 0.0f }, { targetWidth, targetHeight } });
 
     view.setCenter({ cx + targetWidth / 2.0f, cy + targetHeight / 2.0f });
-    target->setView(view);
+    GFX::CommandBuffer::get().setView(*target, view);
 
     room->renderCameraX = cx;
     room->renderCameraY = cy;
@@ -587,6 +915,57 @@ static int RoomInstanceGet(lua_State* L) {
     return 1;
 }
 
+static sf::FloatRect RegionFromArgs(lua_State* L, int idx) {
+    float left = luaL_checknumber(L, idx);
+    float top = luaL_checknumber(L, idx + 1);
+    float right = luaL_checknumber(L, idx + 2);
+    float bottom = luaL_checknumber(L, idx + 3);
+    return { { left, top }, { right - left, bottom - top } };
+}
+
+// room, x1, y1, x2, y2, inside = true
+static int RoomDeactivateRegion(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    bool inside = lua_isnoneornil(L, 6) || lua_toboolean(L, 6);
+    room->deactivateRegion(RegionFromArgs(L, 2), inside);
+    return 0;
+}
+
+// room, x1, y1, x2, y2, inside = true
+static int RoomActivateRegion(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    bool inside = lua_isnoneornil(L, 6) || lua_toboolean(L, 6);
+    room->activateRegion(RegionFromArgs(L, 2), inside);
+    return 0;
+}
+
+static int RoomActivateAll(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    std::vector<Object*> all;
+    for (auto& o : room->deactivated) {
+        all.push_back(o.get());
+    }
+    for (auto o : room->activationQueue) {
+        all.push_back(o);
+    }
+    for (auto o : all) {
+        room->setInstanceActive(o, true);
+    }
+    return 0;
+}
+
+// room, margin | room, false
+static int RoomKeepActiveAroundView(lua_State* L) {
+    Room* room = lua_toclass<Room>(L, 1);
+    if (lua_isnoneornil(L, 2) || (lua_isboolean(L, 2) && !lua_toboolean(L, 2))) {
+        room->keepActiveAroundView = false;
+        return 0;
+    }
+    room->keepActiveAroundView = true;
+    room->keepActiveMargin = (lua_isnumber(L, 2)) ? lua_tonumber(L, 2) : 0.0f;
+    return 0;
+}
+
 static const luaL_Reg roomFunctions[] = {
     { "__index",                RoomGet },
     { "__newindex",             RoomSet },
@@ -596,10 +975,18 @@ static const luaL_Reg roomFunctions[] = {
     { "instance_get",           RoomInstanceGet },
     { "instance_rect",          RoomInstanceRect },
     { "instances_rect",         RoomInstancesRect },
+    { "instance_place",         RoomInstancePlace },
+    { "move_and_collide",       RoomMoveAndCollide },
+    { "raycast",                RoomRaycast },
+    { "raycast_batch",          RoomRaycastBatch },
     { "instance_exists",        RoomInstanceExists },
     { "instance_destroy",       RoomInstanceDestroy },
     { "instance_list_create",   RoomInstanceListCreate },
     { "instance_count",         RoomInstanceCount },
+    { "deactivate_region",      RoomDeactivateRegion },
+    { "activate_region",        RoomActivateRegion },
+    { "activate_all",           RoomActivateAll },
+    { "keep_active_around_view", RoomKeepActiveAroundView },
     { NULL, NULL }
 };
 
@@ -0,0 +1,101 @@
+#include "spatialgrid.h"
+#include "object/object.h"
+
+static SpatialGrid::Entry CellRange(const Object* o) {
+    sf::FloatRect r = o->getBroadphaseRect();
+    SpatialGrid::Entry e;
+    e.left = SpatialGrid::toCell(r.position.x);
+    e.top = SpatialGrid::toCell(r.position.y);
+    e.right = SpatialGrid::toCell(r.position.x + r.size.x);
+    e.bottom = SpatialGrid::toCell(r.position.y + r.size.y);
+    return e;
+}
+
+void SpatialGrid::link(Object* o, const Entry& range) {
+    for (int cx = range.left; cx <= range.right; ++cx) {
+        for (int cy = range.top; cy <= range.bottom; ++cy) {
+            cells[key(cx, cy)].push_back(o);
+        }
+    }
+}
+
+void SpatialGrid::unlink(Object* o, const Entry& range) {
+    for (int cx = range.left; cx <= range.right; ++cx) {
+        for (int cy = range.top; cy <= range.bottom; ++cy) {
+            auto it = cells.find(key(cx, cy));
+            if (it == cells.end()) continue;
+
+            auto& vec = it->second;
+            for (size_t i = 0; i < vec.size(); ++i) {
+                if (vec[i] == o) {
+                    vec[i] = vec.back();
+                    vec.pop_back();
+                    break;
+                }
+            }
+            if (vec.empty()) {
+                cells.erase(it);
+            }
+        }
+    }
+}
+
+void SpatialGrid::insert(Object* o) {
+    if (o->gridEntry.grid != nullptr) {
+        o->gridEntry.grid->remove(o);
+    }
+
+    Entry range = CellRange(o);
+    range.grid = this;
+    // Marks count per grid, one carried over from another grid could match this grid's next query
+    range.mark = 0;
+    link(o, range);
+    o->gridEntry = range;
+}
+
+void SpatialGrid::remove(Object* o) {
+    if (o->gridEntry.grid != this) {
+        return;
+    }
+    unlink(o, o->gridEntry);
+    o->gridEntry.grid = nullptr;
+}
+
+void SpatialGrid::update(Object* o) {
+    if (o->gridEntry.grid != this) {
+        return;
+    }
+
+    Entry range = CellRange(o);
+    Entry& current = o->gridEntry;
+
+    // Most moves stay within the same cells
+    if (range.left == current.left && range.top == current.top &&
+        range.right == current.right && range.bottom == current.bottom) {
+        return;
+    }
+
+    unlink(o, current);
+    link(o, range);
+    current.left = range.left;
+    current.top = range.top;
+    current.right = range.right;
+    current.bottom = range.bottom;
+}
+
+bool SpatialGrid::visitOnce(Object* o) {
+    if (o->gridEntry.mark == queryMark) {
+        return false;
+    }
+    o->gridEntry.mark = queryMark;
+    return true;
+}
+
+void SpatialGrid::clear() {
+    for (auto& [k, vec] : cells) {
+        for (auto o : vec) {
+            o->gridEntry.grid = nullptr;
+        }
+    }
+    cells.clear();
+}
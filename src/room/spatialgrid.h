@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+class Object;
+
+// Uniform hash grid over instance bounds. Rooms use it as the broadphase for
+// region and collision queries so that they don't need to visit every instance.
+class SpatialGrid {
+public:
+    // Cell range an object currently occupies, stored on the object itself
+    struct Entry {
+        SpatialGrid* grid = nullptr;
+        int left = 0, top = 0;
+        int right = -1, bottom = -1;
+        unsigned int mark = 0;
+    };
+
+    static constexpr float cellSize = 64.0f;
+
+    void insert(Object* o);
+    void remove(Object* o);
+    void update(Object* o);
+    void clear();
+
+    size_t cellCount() const { return cells.size(); }
+
+    // Objects in a single cell, or nullptr if the cell is empty
+    const std::vector<Object*>* cell(int cx, int cy) const {
+        auto it = cells.find(key(cx, cy));
+        return (it == cells.end()) ? nullptr : &it->second;
+    }
+
+    static int toCell(float v) {
+        return static_cast<int>(std::floor(v / cellSize));
+    }
+
+    // Inclusive overlap test, so zero-sized bounds (sprite-less instances) still count
+    static bool overlaps(const sf::FloatRect& a, const sf::FloatRect& b) {
+        return a.position.x <= b.position.x + b.size.x && b.position.x <= a.position.x + a.size.x &&
+            a.position.y <= b.position.y + b.size.y && b.position.y <= a.position.y + a.size.y;
+    }
+
+    // Visits every object whose cells touch the rectangle once. The visitor returns false to stop early.
+    // Queries must not be nested, and the visitor must not insert into or remove from this grid.
+    template <typename F>
+    void query(const sf::FloatRect& rect, F&& visit);
+
+private:
+    std::unordered_map<uint64_t, std::vector<Object*>> cells;
+    unsigned int queryMark = 0;
+
+    static uint64_t key(int cx, int cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    void link(Object* o, const Entry& range);
+    void unlink(Object* o, const Entry& range);
+
+    // Marks the object as seen by the current query, false if it already was
+    bool visitOnce(Object* o);
+};
+
+template <typename F>
+void SpatialGrid::query(const sf::FloatRect& rect, F&& visit) {
+    if (cells.empty()) return;
+
+    queryMark++;
+
+    int left = toCell(rect.position.x);
+    int top = toCell(rect.position.y);
+    int right = toCell(rect.position.x + rect.size.x);
+    int bottom = toCell(rect.position.y + rect.size.y);
+
+    for (int cx = left; cx <= right; ++cx) {
+        for (int cy = top; cy <= bottom; ++cy) {
+            auto it = cells.find(key(cx, cy));
+            if (it == cells.end()) continue;
+
+            for (Object* o : it->second) {
+                if (!visitOnce(o)) continue;
+                if (!visit(o)) return;
+            }
+        }
+    }
+}
@@ -1,8 +1,34 @@
+#include <algorithm>
 #include "tilemap.h"
 #include "../gfx/tileset.h"
 #include "util/mathhelper.h"
 #include "room/room.h"
 #include "game.h"
+#include "gfx/spritebatch.h"
+#include "gfx/commandbuffer.h"
+#include "gfx/renderthread.h"
+
+// Takes a position inside a tile (0 to 1 on both axes) to where it is in the tileset,
+// undoing the same mirror, flip, rotate order drawVertices applies to texture coordinates
+static sf::Vector2f TileToTileset(unsigned int tile, sf::Vector2f p) {
+    if (tile & (1 << 30)) p = { p.y, 1.0f - p.x };
+    if (tile & (1 << 29)) p.y = 1.0f - p.y;
+    if (tile & (1 << 28)) p.x = 1.0f - p.x;
+    return p;
+}
+
+// Takes a direction from tileset space back to inside the tile, the linear part of TileToTileset reversed
+static sf::Vector2f TilesetToTileDirection(unsigned int tile, sf::Vector2f n) {
+    if (tile & (1 << 28)) n.x = -n.x;
+    if (tile & (1 << 29)) n.y = -n.y;
+    if (tile & (1 << 30)) n = { -n.y, n.x };
+    return n;
+}
+
+// Floor line of a slope at a tileset space x, as a y coordinate (down is positive)
+static inline float SlopeFloor(const TileCollision& tc, float u) {
+    return 1.0f - (tc.left + (tc.right - tc.left) * u);
+}
 
 void Tilemap::draw(Room* room, float alpha) {
     auto& game = Game::get();
@@ -20,21 +46,87 @@ void Tilemap::drawVertices(Room *room, float alpha, float cx, float cy, float w,
 
     sf::RenderTarget* target = game.getRenderTarget();
 
-    int thisCx =    std::max(0, (static_cast<int>(cx) / tileWidth));
-    int thisCx2 =   thisCx + static_cast<int>(ceilf(w / (float)tileWidth)) + 1;
-    int fullW =     std::min(thisCx2, tileCountX);
-    
-    int thisCy =    std::max(0, (static_cast<int>(cy) / tileHeight));
-    int thisCy2 =   thisCy + static_cast<int>(ceilf(h / (float)tileHeight)) + 1;
-    int fullH =     std::min(thisCy2, tileCountY);
+    int newChunkCountX = (tileCountX + chunkSize - 1) / chunkSize;
+    int newChunkCountY = (tileCountY + chunkSize - 1) / chunkSize;
+    if (newChunkCountX != chunkCountX || newChunkCountY != chunkCountY) {
+        chunkCountX = newChunkCountX;
+        chunkCountY = newChunkCountY;
+        chunks.clear();
+        chunks.resize(static_cast<size_t>(chunkCountX) * chunkCountY);
+    }
+
+    float chunkWidth = static_cast<float>(tileWidth * chunkSize);
+    float chunkHeight = static_cast<float>(tileHeight * chunkSize);
+
+    int thisCx =    std::max(0, static_cast<int>(std::floor(cx / chunkWidth)));
+    int fullW =     std::min(chunkCountX, static_cast<int>(std::floor((cx + w) / chunkWidth)) + 1);
+
+    int thisCy =    std::max(0, static_cast<int>(std::floor(cy / chunkHeight)));
+    int fullH =     std::min(chunkCountY, static_cast<int>(std::floor((cy + h) / chunkHeight)) + 1);
+
+    sf::Shader* shader = Game::get().currentShader;
+
+    sf::RenderStates states;
+    states.texture = &tileset->tex;
+    states.shader = shader;
+
+    GFX::SpriteBatch::get().flush();
+
+    for (int yy = thisCy; yy < fullH; ++yy) {
+        for (int xx = thisCx; xx < fullW; ++xx) {
+            Chunk& chunk = chunks[xx + yy * chunkCountX];
+            if (chunk.dirty) {
+                buildChunk(xx, yy);
+            }
+            if (chunk.vertexCount == 0) continue;
+
+            if (chunk.uploaded) {
+                GFX::CommandBuffer::get().drawBuffer(*target, chunk.buffer, chunk.vertexCount, states);
+            }
+            else {
+                GFX::CommandBuffer::get().drawTriangles(*target, chunk.vertices.data(), chunk.vertexCount, states);
+            }
+        }
+    }
+}
+
+Tilemap::~Tilemap() {
+    // Recorded draws only point at the chunk buffers, run them while the buffers still exist
+    auto& commands = GFX::CommandBuffer::get();
+    for (auto& chunk : chunks) {
+        if (commands.references(chunk.buffer)) {
+            commands.submit();
+            break;
+        }
+    }
+    GFX::RenderThread::get().waitIdle();
+}
+
+void Tilemap::buildChunk(int cx, int cy) {
+    Chunk& chunk = chunks[cx + cy * chunkCountX];
+    // Draws of the old contents recorded this frame have to run before the buffer changes under them,
+    // and the previous frame may still be drawing it
+    auto& commands = GFX::CommandBuffer::get();
+    if (commands.references(chunk.buffer)) {
+        commands.submit();
+    }
+    GFX::RenderThread::get().waitIdle();
+    chunk.dirty = false;
+    chunk.uploaded = false;
+    chunk.vertices.clear();
 
+    int tileWidth = tileset->tileWidth;
+    int tileHeight = tileset->tileHeight;
     int padding = tileset->padding;
 
     int totalTiles = tileData.size();
-    sf::VertexArray vertices(sf::PrimitiveType::Triangles);
-    
-    for (int xx = thisCx; xx < fullW; ++xx) {
-        for (int yy = thisCy; yy < fullH; ++yy) {
+    int firstX = cx * chunkSize;
+    int firstY = cy * chunkSize;
+    int lastX = std::min(firstX + chunkSize, tileCountX);
+    int lastY = std::min(firstY + chunkSize, tileCountY);
+
+    for (int xx = firstX; xx < lastX; ++xx) {
+        for (int yy = firstY; yy < lastY; ++yy) {
             int pos = xx + (yy * tileCountX);
             if (pos >= totalTiles || pos < 0) continue;
 
@@ -87,22 +179,44 @@ void Tilemap::drawVertices(Room *room, float alpha, float cx, float cy, float w,
                 texCoords[1] = temp;
             }
 
-            vertices.append(sf::Vertex{positions[0], sf::Color::White, texCoords[0]});
-            vertices.append(sf::Vertex{positions[1], sf::Color::White, texCoords[1]});
-            vertices.append(sf::Vertex{positions[2], sf::Color::White, texCoords[2]});
+            chunk.vertices.push_back(sf::Vertex{positions[0], sf::Color::White, texCoords[0]});
+            chunk.vertices.push_back(sf::Vertex{positions[1], sf::Color::White, texCoords[1]});
+            chunk.vertices.push_back(sf::Vertex{positions[2], sf::Color::White, texCoords[2]});
             
-            vertices.append(sf::Vertex{positions[0], sf::Color::White, texCoords[0]});
-            vertices.append(sf::Vertex{positions[2], sf::Color::White, texCoords[2]});
-            vertices.append(sf::Vertex{positions[3], sf::Color::White, texCoords[3]});
+            chunk.vertices.push_back(sf::Vertex{positions[0], sf::Color::White, texCoords[0]});
+            chunk.vertices.push_back(sf::Vertex{positions[2], sf::Color::White, texCoords[2]});
+            chunk.vertices.push_back(sf::Vertex{positions[3], sf::Color::White, texCoords[3]});
         }
     }
 
-    sf::Shader* shader = Game::get().currentShader;
+    chunk.vertexCount = chunk.vertices.size();
+    if (chunk.vertexCount == 0 || !sf::VertexBuffer::isAvailable()) {
+        return;
+    }
 
-    sf::RenderStates states;
-    states.texture = &tileset->tex;
-    states.shader = shader;
-    target->draw(vertices, states);
+    // Grow the buffer when needed, then the CPU copy isn't needed anymore
+    if (chunk.buffer.getVertexCount() < chunk.vertexCount && !chunk.buffer.create(chunk.vertexCount)) {
+        return;
+    }
+    chunk.uploaded = chunk.buffer.update(chunk.vertices.data(), chunk.vertexCount, 0);
+    if (chunk.uploaded) {
+        chunk.vertices.clear();
+        chunk.vertices.shrink_to_fit();
+    }
+}
+
+void Tilemap::markChunkDirty(int x, int y) {
+    int cx = x / chunkSize;
+    int cy = y / chunkSize;
+    if (cx < chunkCountX && cy < chunkCountY) {
+        chunks[cx + cy * chunkCountX].dirty = true;
+    }
+}
+
+void Tilemap::markAllChunksDirty() {
+    for (auto& chunk : chunks) {
+        chunk.dirty = true;
+    }
 }
 
 int Tilemap::get(int x, int y) {
@@ -133,9 +247,147 @@ void Tilemap::set(int x, int y, int value) {
     int pos = x + (y * tileCountX);
     if (pos >= 0 && pos < tileCountX * tileCountY) {
         tileData[pos] = value;
+        markChunkDirty(pos % tileCountX, pos / tileCountX);
+        changed();
+    }
+}
+
+bool Tilemap::pointSolid(float px, float py) const {
+    if (!tileset || tileset->tileWidth == 0 || tileset->tileHeight == 0) return false;
+
+    float cellX = px / tileset->tileWidth;
+    float cellY = py / tileset->tileHeight;
+    int xx = static_cast<int>(std::floor(cellX));
+    int yy = static_cast<int>(std::floor(cellY));
+    if (xx < 0 || yy < 0 || xx >= tileCountX || yy >= tileCountY) return false;
+
+    unsigned int tile = tileData[xx + yy * tileCountX];
+    const TileCollision& tc = tileset->tileCollision(tile & ((1 << 19) - 1));
+    switch (tc.shape) {
+        case TileShape::EMPTY: return false;
+        case TileShape::SOLID: return true;
+        case TileShape::SLOPE: {
+            sf::Vector2f p = TileToTileset(tile, { cellX - xx, cellY - yy });
+            return p.y >= SlopeFloor(tc, p.x);
+        }
+    }
+    return false;
+}
+
+template <typename F>
+void Tilemap::visitOverlapping(const sf::FloatRect& rect, F&& visit) const {
+    if (!tileset || tileset->tileWidth == 0 || tileset->tileHeight == 0) return;
+    if (rect.size.x <= 0 || rect.size.y <= 0) return;
+
+    float tw = tileset->tileWidth;
+    float th = tileset->tileHeight;
+    float right = rect.position.x + rect.size.x;
+    float bottom = rect.position.y + rect.size.y;
+
+    // Only tiles the rectangle overlaps with some area, touching an edge doesn't count
+    int x1 = std::max(0, static_cast<int>(std::floor(rect.position.x / tw)));
+    int y1 = std::max(0, static_cast<int>(std::floor(rect.position.y / th)));
+    int x2 = std::min(tileCountX, static_cast<int>(std::ceil(right / tw)));
+    int y2 = std::min(tileCountY, static_cast<int>(std::ceil(bottom / th)));
+
+    int idMask = (1 << 19) - 1;
+    for (int yy = y1; yy < y2; ++yy) {
+        for (int xx = x1; xx < x2; ++xx) {
+            unsigned int tile = tileData[xx + yy * tileCountX];
+            const TileCollision& tc = tileset->tileCollision(tile & idMask);
+            if (tc.shape == TileShape::EMPTY) continue;
+            if (tc.shape == TileShape::SOLID) {
+                if (!visit(xx, yy)) return;
+                continue;
+            }
+
+            // Flips and quarter turns keep the rectangle axis aligned in tileset space
+            sf::Vector2f a = TileToTileset(tile, {
+                std::max(0.0f, rect.position.x / tw - xx),
+                std::max(0.0f, rect.position.y / th - yy) });
+            sf::Vector2f b = TileToTileset(tile, {
+                std::min(1.0f, right / tw - xx),
+                std::min(1.0f, bottom / th - yy) });
+            float u1 = std::min(a.x, b.x), u2 = std::max(a.x, b.x);
+            float v2 = std::max(a.y, b.y);
+
+            // The floor is a line, so its highest point over the span is at one of the ends
+            float highest = std::min(SlopeFloor(tc, u1), SlopeFloor(tc, u2));
+            if (v2 > highest && !visit(xx, yy)) return;
+        }
     }
 }
 
+bool Tilemap::rectMeeting(const sf::FloatRect& rect, const std::vector<int>* ignore) const {
+    bool meeting = false;
+    visitOverlapping(rect, [&](int xx, int yy) {
+        if (ignore && std::find(ignore->begin(), ignore->end(), xx + yy * tileCountX) != ignore->end()) return true;
+        meeting = true;
+        return false;
+    });
+    return meeting;
+}
+
+void Tilemap::overlappingTiles(const sf::FloatRect& rect, std::vector<int>& out) const {
+    visitOverlapping(rect, [&](int xx, int yy) {
+        out.push_back(xx + yy * tileCountX);
+        return true;
+    });
+}
+
+bool Tilemap::raycast(sf::Vector2f from, sf::Vector2f to, float& t, sf::Vector2f& normal) const {
+    if (!tileset || tileset->tileWidth == 0 || tileset->tileHeight == 0) return false;
+
+    float tw = tileset->tileWidth;
+    float th = tileset->tileHeight;
+    sf::Vector2f d = to - from;
+    int idMask = (1 << 19) - 1;
+    bool hit = false;
+
+    TraverseGrid(from, to, { tw, th }, [&](int xx, int yy, float tEnter, float tExit, sf::Vector2f faceNormal) {
+        if (xx < 0 || yy < 0 || xx >= tileCountX || yy >= tileCountY) return true;
+
+        unsigned int tile = tileData[xx + yy * tileCountX];
+        const TileCollision& tc = tileset->tileCollision(tile & idMask);
+        if (tc.shape == TileShape::EMPTY) return true;
+
+        if (tc.shape == TileShape::SOLID) {
+            t = tEnter;
+            normal = faceNormal;
+            hit = true;
+            return false;
+        }
+
+        // Distance into the slope's solid side is linear along the ray, so find where it crosses zero
+        auto local = [&](float at) {
+            return sf::Vector2f { (from.x + d.x * at) / tw - xx, (from.y + d.y * at) / th - yy };
+        };
+        sf::Vector2f a = TileToTileset(tile, local(tEnter));
+        sf::Vector2f b = TileToTileset(tile, local(tExit));
+        float depthA = a.y - SlopeFloor(tc, a.x);
+        float depthB = b.y - SlopeFloor(tc, b.x);
+
+        if (depthA >= 0) {
+            t = tEnter;
+            normal = faceNormal;
+            hit = true;
+            return false;
+        }
+        if (depthB >= 0) {
+            t = tEnter + (tExit - tEnter) * (depthA / (depthA - depthB));
+            sf::Vector2f n = TilesetToTileDirection(tile, { tc.left - tc.right, -1.0f });
+            n = { n.x / tw, n.y / th };
+            float len = std::sqrt(n.x * n.x + n.y * n.y);
+            normal = { n.x / len, n.y / len };
+            hit = true;
+            return false;
+        }
+        return true;
+    });
+
+    return hit;
+}
+
 void Tilemap::setExt(int x, int y, int value, bool mirror, bool flip, bool rotate) {
     int pos = x + (y * tileCountX);
     if (pos >= 0 && pos < tileCountX * tileCountY) {
@@ -144,5 +396,35 @@ void Tilemap::setExt(int x, int y, int value, bool mirror, bool flip, bool rotat
         if (flip)   finalValue |= (1 << 29);
         if (rotate) finalValue |= (1 << 30);
         tileData[pos] = finalValue;
+        markChunkDirty(pos % tileCountX, pos / tileCountX);
+        changed();
     }
 }
+
+void Tilemap::changed() {
+    static unsigned int nextVersion = 1;
+    version = nextVersion++;
+}
+
+std::shared_ptr<const SolidityGrid> Tilemap::soliditySnapshot() {
+    if (snapshot && snapshot->version == version) {
+        return snapshot;
+    }
+
+    auto grid = std::make_shared<SolidityGrid>();
+    grid->width = tileCountX;
+    grid->height = tileCountY;
+    grid->version = version;
+    grid->blocked.assign(static_cast<size_t>(tileCountX) * tileCountY, 0);
+    if (tileset) {
+        grid->tileWidth = tileset->tileWidth;
+        grid->tileHeight = tileset->tileHeight;
+        int idMask = (1 << 19) - 1;
+        for (size_t i = 0; i < grid->blocked.size() && i < tileData.size(); ++i) {
+            grid->blocked[i] = tileset->tileCollision(tileData[i] & idMask).shape != TileShape::EMPTY;
+        }
+    }
+
+    snapshot = grid;
+    return snapshot;
+}
@@ -1,8 +1,21 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include "object/object.h"
 
+// Which cells are blocked, copied out of a tilemap so worker threads can read it while the tilemap keeps changing
+struct SolidityGrid {
+    int width = 0, height = 0;
+    float tileWidth = 0, tileHeight = 0;
+    unsigned int version = 0;
+    std::vector<uint8_t> blocked;
+
+    bool isBlocked(int x, int y) const {
+        return x < 0 || y < 0 || x >= width || y >= height || blocked[x + y * width];
+    }
+};
+
 class Tileset;
 class Tilemap : public Object {
 public:
@@ -10,11 +23,54 @@ public:
     int tileCountX, tileCountY;
     std::string name;
     Tileset* tileset;
-    Tilemap(LuaState L) : Object(L) {}
+    // Moves on with every tile or tileset change, and is never shared between two tilemaps
+    unsigned int version;
+    // Drawn through the room's layer cache together with cached tilemaps next to it in draw order
+    bool cached = false;
+    Tilemap(LuaState L) : Object(L) { kind = InstanceKind::TILEMAP; changed(); }
+    ~Tilemap() override;
+    bool intersectsView(const sf::FloatRect& viewRect, float alpha) const override { return true; }
     void draw(Room* room, float alpha) override;
     void drawVertices(Room* room, float alpha, float x, float y, float w, float h);
     int get(int x, int y);
     std::tuple<int, bool, bool, bool> getExt(int x, int y);
     void set(int x, int y, int value);
     void setExt(int x, int y, int value, bool mirror, bool flip, bool rotate);
+
+    // Solidity from the tileset's collision metadata, in room coordinates
+    bool pointSolid(float px, float py) const;
+    // Tiles listed in ignore (as x + y * tileCountX) are treated as empty
+    bool rectMeeting(const sf::FloatRect& rect, const std::vector<int>* ignore = nullptr) const;
+    // Every tile rectMeeting would find solid under the rectangle, in the same x + y * tileCountX form
+    void overlappingTiles(const sf::FloatRect& rect, std::vector<int>& out) const;
+    // First solid point along the segment, as a fraction of its length
+    bool raycast(sf::Vector2f from, sf::Vector2f to, float& t, sf::Vector2f& normal) const;
+
+    void changed();
+    // Rebuilt on demand once the version has moved on. Anything that isn't an empty tile is blocked.
+    std::shared_ptr<const SolidityGrid> soliditySnapshot();
+
+    // Geometry is kept per square of chunkSize tiles and only rebuilt after a tile in it changes
+    static constexpr int chunkSize = 16;
+    void markChunkDirty(int x, int y);
+    void markAllChunksDirty();
+
+private:
+    std::shared_ptr<const SolidityGrid> snapshot;
+
+    struct Chunk {
+        sf::VertexBuffer buffer { sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Static };
+        // Only kept when the buffer doesn't hold them, vertex buffers being unavailable or the upload failing
+        std::vector<sf::Vertex> vertices;
+        size_t vertexCount = 0;
+        bool uploaded = false;
+        bool dirty = true;
+    };
+    std::vector<Chunk> chunks;
+    int chunkCountX = 0, chunkCountY = 0;
+
+    void buildChunk(int cx, int cy);
+    // Calls visit(xx, yy) for each solid tile the rectangle overlaps with some area, until it returns false
+    template <typename F>
+    void visitOverlapping(const sf::FloatRect& rect, F&& visit) const;
 };
\ No newline at end of file
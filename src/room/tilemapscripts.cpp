@@ -24,15 +24,27 @@ static int TilemapSetVisible(lua_State* L) {
     return 0;
 }
 
+static int TilemapGetCached(lua_State* L) {
+    lua_pushboolean(L, lua_toclass<Tilemap>(L, 1)->cached);
+    return 1;
+}
+
+static int TilemapSetCached(lua_State* L) {
+    lua_toclass<Tilemap>(L, 1)->cached = lua_toboolean(L, 3);
+    return 0;
+}
+
 static const luaL_Reg tilemapIndexFields[] = {
     { "depth", TilemapGetDepth },
     { "visible", TilemapGetVisible },
+    { "cached", TilemapGetCached },
     { NULL, NULL }
 };
 
 static const luaL_Reg tilemapNewIndexFields[] = {
     { "depth", TilemapSetDepth },
     { "visible", TilemapSetVisible },
+    { "cached", TilemapSetCached },
     { NULL, NULL }
 };
 
@@ -114,10 +126,32 @@ static int TilemapDrawVertices(lua_State* L) {
     return 0;
 }
 
+// tilemap, x, y
+static int TilemapPointSolid(lua_State* L) {
+    Tilemap* tilemap = lua_toclass<Tilemap>(L, 1);
+    float x = luaL_checknumber(L, 2);
+    float y = luaL_checknumber(L, 3);
+    lua_pushboolean(L, tilemap->pointSolid(x, y));
+    return 1;
+}
+
+// tilemap, x1, y1, x2, y2
+static int TilemapRectMeeting(lua_State* L) {
+    Tilemap* tilemap = lua_toclass<Tilemap>(L, 1);
+    float left = luaL_checknumber(L, 2);
+    float top = luaL_checknumber(L, 3);
+    float right = luaL_checknumber(L, 4);
+    float bottom = luaL_checknumber(L, 5);
+    lua_pushboolean(L, tilemap->rectMeeting({ { left, top }, { right - left, bottom - top } }));
+    return 1;
+}
+
 static int TilemapSetTileset(lua_State* L) {
     Tilemap* tilemap = lua_toclass<Tilemap>(L, 1);
     Tileset* tileset = lua_toclass<Tileset>(L, 2);
     tilemap->tileset = tileset;
+    tilemap->markAllChunksDirty();
+    tilemap->changed();
     return 0;
 }
 
@@ -161,6 +195,8 @@ static const luaL_Reg tilemapMetaFunctions[] = {
     { "set_tileset",    TilemapSetTileset },
     { "draw_vertices",  TilemapDrawVertices },
     { "draw_vertices_ext",  TilemapDrawVerticesExt },
+    { "point_solid",    TilemapPointSolid },
+    { "rect_meeting",   TilemapRectMeeting },
     { NULL, NULL }
 };
 
@@ -290,6 +290,7 @@ public:
 	int bboxRight;
 	int bboxTop;
 	int bboxBottom;
+	bool precise;
 	void read(json& j, GameMakerProject* proj) override {
 		GMDirectoryResource::read(j, proj);
 		proj->managed["sprites"].push_back(name);
@@ -302,6 +303,9 @@ public:
 		bboxRight = j["bbox_right"];
 		bboxTop = j["bbox_top"];
 		bboxBottom = j["bbox_bottom"];
+		// 0 is precise, 4 is precise per frame
+		int collisionKind = j.value("collisionKind", 1);
+		precise = collisionKind == 0 || collisionKind == 4;
 
 		for (auto& f : j["frames"]) {
 			std::unique_ptr frame = std::make_unique<Frame>();
@@ -344,7 +348,8 @@ public:
 				// { "name", name },
 				{ "size", { width, height } },
 				{ "origin", { originX, originY } },
-				{ "hitbox", { bboxLeft, bboxTop, bboxRight, bboxBottom } }
+				{ "hitbox", { bboxLeft, bboxTop, bboxRight, bboxBottom } },
+				{ "precise", precise }
 			};
 			// j["frames"] = frames.size();
 			std::ofstream o(path / "data.json");
@@ -1249,4 +1254,4 @@ void GMConvert() {
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "jobpool.h"
+
+JobPool::JobPool() {
+    // Leave a core for the main thread
+    unsigned int count = std::thread::hardware_concurrency();
+    count = (count > 1) ? count - 1 : 1;
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.emplace_back(&JobPool::work, this);
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+size_t JobPool::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size();
+}
+
+void JobPool::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            // Queued jobs still run when stopping, someone may be waiting on their results
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for work that never touches Lua or SFML, like pathfinding.
+// Jobs get everything they need up front and publish results through state they share with the caller.
+class JobPool {
+public:
+    static JobPool& get() {
+        static JobPool pool;
+        return pool;
+    }
+
+    void submit(std::function<void()> job);
+
+    // Jobs queued but not yet picked up by a worker
+    size_t pending();
+
+    // Finishes every queued job before the workers exit
+    ~JobPool();
+
+private:
+    JobPool();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void work();
+};
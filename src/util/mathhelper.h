@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <limits>
 
 #ifndef M_PI
 #define M_PI   3.14159265358979323846264338327950288
@@ -30,6 +31,48 @@ inline float PointDistance(float x1, float y1, float x2, float y2) {
     return sqrt(pow(x2 - x1, 2) + pow(y2 - y1, 2) * 1.0);
 }
 
+// Amanatides-Woo walk over the cells of a uniform grid that a segment passes through, in order.
+// visit(cx, cy, tEnter, tExit, normal) gets the part of the segment (0 to 1) spent in the cell and the
+// normal of the face it was entered through (zero for the starting cell). Returning false stops the walk.
+template <typename F>
+inline void TraverseGrid(sf::Vector2f from, sf::Vector2f to, sf::Vector2f cellSize, F&& visit) {
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    sf::Vector2f d = to - from;
+
+    int cx = static_cast<int>(std::floor(from.x / cellSize.x));
+    int cy = static_cast<int>(std::floor(from.y / cellSize.y));
+    int endX = static_cast<int>(std::floor(to.x / cellSize.x));
+    int endY = static_cast<int>(std::floor(to.y / cellSize.y));
+
+    int stepX = (d.x > 0) ? 1 : (d.x < 0) ? -1 : 0;
+    int stepY = (d.y > 0) ? 1 : (d.y < 0) ? -1 : 0;
+    float tDeltaX = (stepX != 0) ? cellSize.x / std::fabs(d.x) : inf;
+    float tDeltaY = (stepY != 0) ? cellSize.y / std::fabs(d.y) : inf;
+    float tMaxX = (stepX == 0) ? inf : (((stepX > 0) ? cx + 1 : cx) * cellSize.x - from.x) / d.x;
+    float tMaxY = (stepY == 0) ? inf : (((stepY > 0) ? cy + 1 : cy) * cellSize.y - from.y) / d.y;
+
+    float tEnter = 0.0f;
+    sf::Vector2f normal {};
+    while (true) {
+        float tExit = std::min(std::min(tMaxX, tMaxY), 1.0f);
+        if (!visit(cx, cy, tEnter, tExit, normal)) return;
+        if (tExit >= 1.0f || (cx == endX && cy == endY)) return;
+
+        if (tMaxX < tMaxY) {
+            cx += stepX;
+            tEnter = tMaxX;
+            tMaxX += tDeltaX;
+            normal = { static_cast<float>(-stepX), 0.0f };
+        }
+        else {
+            cy += stepY;
+            tEnter = tMaxY;
+            tMaxY += tDeltaY;
+            normal = { 0.0f, static_cast<float>(-stepY) };
+        }
+    }
+}
+
 inline sf::Color MakeColor(std::tuple<int, int, int, int> c) {
     uint8_t r = std::get<0>(c);
     uint8_t g = std::get<1>(c);